@@ -4,11 +4,14 @@
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
+#include <charconv>
 #include <iomanip>
-#include <boost/regex.hpp>
+#include <string_view>
 
 class Logger {
 public:
+    inline bool enabled() const { return gamesolver::broker_logging; }
+
     void log(const std::string& msg) const
     {
         if (gamesolver::broker_logging == false) return;
@@ -20,10 +23,17 @@ public:
 
     class OstreamAdapter : public std::stringstream {
     public:
-        OstreamAdapter(Logger& logref) : std::stringstream(), logref(logref) {}
+        // with logging off the stream is bad from the start, so the chained insertions format nothing
+        OstreamAdapter(Logger& logref) : std::stringstream(), logref(logref)
+        {
+            if (!logref.enabled()) setstate(std::ios_base::badbit);
+        }
         OstreamAdapter(OstreamAdapter&& out) : std::stringstream(std::move(out)), logref(out.logref) {}
         OstreamAdapter(const OstreamAdapter&) = delete;
-        ~OstreamAdapter() { logref.log(str()); }
+        ~OstreamAdapter()
+        {
+            if (!bad()) logref.log(str());
+        }
 
     private:
         Logger& logref;
@@ -33,7 +43,7 @@ public:
     OstreamAdapter operator<<(const type& t)
     {
         OstreamAdapter out(*this);
-        out << t;
+        if (!out.bad()) out << t;
         return out;
     }
 } _log;
@@ -87,7 +97,7 @@ std::ostream& operator<<(std::ostream& out, const JobState& state)
     return out << names[std::min<int>(state, 5)];
 }
 
-std::ostream& operator<<(std::ostream& out, const Job& job) { return out << job.toString(); }
+std::ostream& operator<<(std::ostream& out, const Job& job) { return out ? out << job.toString() : out; }
 
 BrokerAdapter::BrokerAdapter(boost::asio::io_context& io_context, const std::string& name, const std::string& broker) : io_context_(io_context), socket_(io_context), name_(name), broker_(broker) {}
 
@@ -146,188 +156,45 @@ std::shared_ptr<Job> BrokerAdapter::waitJobUntil(std::shared_ptr<Job> job, JobSt
     }
 }
 
-boost::regex _regex_message_from("^(\\S+) >> (.+)$");
-boost::regex _regex_confirm_request("^(accept|reject) request ([0-9]+)? ?(\\{(.+)\\})?$");
-boost::regex _regex_response("^response ([0-9]+) (.+) \\{(.*)\\}$");
-boost::regex _regex_notify_assign("^notify assign request ([0-9]+) to (\\S+)$");
-boost::regex _regex_notify_state("^notify state (idle|busy|full)( ([0-9]+)/([0-9]+)( (.+))?)?$");
-boost::regex _regex_notify_capacity("^notify capacity ([0-9]+) ?(.*)$");
-boost::regex _regex_confirm_terminate("^(accept|confirm|reject) terminate ([0-9]+)$");
-boost::regex _regex_confirm_protocol("^(accept|reject) protocol (.+)$");
+namespace {
 
-void BrokerAdapter::handleInput(const std::string& input)
+// splits the first space-separated word off the text
+std::string_view takeWord(std::string_view& text)
 {
-    boost::smatch match;
-    if (boost::regex_match(input, match, _regex_message_from)) {
-        // ^(\\S+) >> (.+)$
-        std::string sender = match[1].str();
-        std::string message = match[2].str();
-
-        if (sender == broker_) {
-            if (boost::regex_match(message, match, _regex_confirm_request)) {
-                // ^(accept|reject) request ([0-9]+)? ?(\\{(.+)\\})?$
-                bool accepted = (match[1].str() == "accept");
-                JobID id = accepted ? std::stoull(match[2].str()) : NullJobID;
-                std::string command = match[4].str();
-
-                std::function<bool(std::shared_ptr<Job>)> match_request = [](auto) { return false; };
-                if (command.size()) { // a new job (requested without id) has been accepted or rejected
-                    match_request = [&](std::shared_ptr<Job> job) { return job->command_ == command && job->id_ == NullJobID; };
-                } else if (id != NullJobID) { // an accepted job with rejected result has been accepted again
-                    match_request = [=](std::shared_ptr<Job> job) { return job->id_ == id; };
-                }
-
-                std::shared_ptr<Job> job;
-                {
-                    std::scoped_lock lock(unconfirmed_mutex_);
-                    auto it = std::find_if(unconfirmed_.begin(), unconfirmed_.end(), match_request);
-                    if (it != unconfirmed_.end()) {
-                        job = *it;
-                        unconfirmed_.erase(it);
-                    }
-                }
-                if (job) {
-                    job->id_ = id;
-                    job->state_ = JobState::JobConfirmed;
-                    if (accepted) {
-                        accepted_.insert({id, job});
-                    }
-                    onJobConfirmed(job, accepted);
-                    _log << boost::format("confirm %sed request %llu {%s}") % match[1] % id % command << std::endl;
-
-                    notifyAllWaits();
-
-                } else {
-                    _log << boost::format("ignore the confirmation of nonexistent request %llu {%s}") % id % command << std::endl;
-                }
-
-            } else if (boost::regex_match(message, match, _regex_response)) {
-                // ^response ([0-9]+) (.+) \\{(.*)\\}$
-                JobID id = std::stoull(match[1].str());
-                std::string code = match[2].str();
-                std::string output = match[3].str();
-
-                std::shared_ptr<Job> job;
-                auto it = accepted_.find(id);
-                if (it != accepted_.end()) {
-                    job = it->second;
-                    accepted_.erase(it);
-                }
-                if (job) {
-                    try {
-                        job->code_ = std::stol(code);
-                        job->output_ = output;
-                        job->state_ = JobState::JobCompleted;
-                    } catch (std::invalid_argument&) {
-                        job->code_ = -1;
-                        job->output_ = code;
-                        job->state_ = JobState::JobTerminated;
-                    }
-                    bool accept = onJobCompleted(job);
-                    if (!accept) {
-                        std::scoped_lock lock(unconfirmed_mutex_);
-                        job->state_ = JobState::JobUnconfirmed;
-                        unconfirmed_.push_back(job);
-                    }
-                    std::string confirm = accept ? "accept" : "reject";
-                    outputAsync(confirm + " response " + std::to_string(id));
-                    _log << boost::format("%s response %llu %s {%s}") % confirm % id % code % output << std::endl;
-
-                    notifyAllWaits();
-
-                } else {
-                    _log << boost::format("ignore the response of nonexistent request %llu") % id << std::endl;
-                }
-
-            } else if (boost::regex_match(message, match, _regex_notify_state)) {
-                // ^notify state (idle|busy|full)( ([0-9]+)/([0-9]+)( (.+))?)?$
-                std::string state = match[1].str();
-                size_t loading = 0, capacity = 0;
-                if (match[2].str().size()) {
-                    loading = std::stoull(match[3].str());
-                    capacity = std::stoull(match[4].str());
-                }
-                std::string details = match[6].str();
-                onStateChanged(state, loading, capacity, details);
-                _log << boost::format("confirm %s state %s %d/%d %s") % broker_ % state % loading % capacity % details << std::endl;
-
-            } else if (boost::regex_match(message, match, _regex_notify_assign)) {
-                // ^notify assign request ([0-9]+) to (\\S+)$
-                JobID id = std::stoull(match[1].str());
-                std::string worker = match[2].str();
-
-                std::shared_ptr<Job> job;
-                auto it = accepted_.find(id);
-                if (it != accepted_.end()) {
-                    job = it->second;
-                }
-                if (job) {
-                    job->output_ = worker;
-                    job->state_ = JobState::JobAssigned;
-                    onJobAssigned(job, worker);
-                    _log << boost::format("confirm request %llu assigned to worker %s") % id % worker << std::endl;
-
-                    notifyAllWaits();
-
-                } else {
-                    _log << boost::format("ignore the confirmation of nonexistent request %llu assigned to worker %s") % id % worker << std::endl;
-                }
-
-            } else if (boost::regex_match(message, match, _regex_notify_capacity)) {
-                // ^notify capacity ([0-9]+) ?(.*)$
-                size_t capacity = std::stoull(match[1].str());
-                std::string details = match[2].str();
-                onCapacityChanged(capacity, details);
-                _log << boost::format("confirm capacity %llu with '%s'") % capacity % details << std::endl;
-
-            } else if (boost::regex_match(message, match, _regex_confirm_terminate)) {
-                // ^(accept|confirm|reject) terminate ([0-9]+)$
-                bool accepted = (match[1].str() != "reject");
-                JobID id = accepted ? std::stoull(match[2].str()) : NullJobID;
-
-                std::shared_ptr<Job> job;
-                auto it = accepted_.find(id);
-                if (it != accepted_.end()) {
-                    job = it->second;
-                    accepted_.erase(it);
-                }
-                if (job) {
-                    job->code_ = -1;
-                    job->output_ = "terminate";
-                    job->state_ = JobState::JobTerminated;
-                    bool accept = onJobCompleted(job);
-                    if (!accept) {
-                        _log << "job terminated by client can not be enqueued again" << std::endl;
-                    }
-                    _log << boost::format("confirm %sed terminate request %llu") % match[1] % id << std::endl;
-
-                    notifyAllWaits();
-                }
-
-            } else if (boost::regex_match(message, match, _regex_confirm_protocol)) {
-                // ^(accept|reject) protocol (.+)$
-                bool accepted = (match[1].str() == "accept");
-                if (accepted) {
-                    _log << boost::format("handshake with %s successfully") % broker_ << std::endl;
-
-                    for (const std::string& item : listSubscribedItems()) {
-                        outputAsync("subscribe " + item);
-                    }
-
-                    notifyAllWaits();
-                } else {
-                    handleHandshakeError(message);
-                }
-
-            } else /* message does not match any watched formats */ {
-                if (!handleExtendedMessage(message, sender)) {
-                    _log << boost::format("ignore message '%s' from %s") % message % sender << std::endl;
-                }
-            }
+    size_t end = text.find(' ');
+    std::string_view word = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return word;
+}
+
+template <typename type>
+bool parseNumber(std::string_view text, type& value)
+{
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return (!text.empty() && result.ec == std::errc() && result.ptr == end);
+}
 
-        } else /* if (sender != broker_) */ {
-            if (!handleExtendedMessage(message, sender)) {
-                _log << boost::format("ignore message '%s' from %s") % message % sender << std::endl;
+bool parseBraced(std::string_view text, std::string_view& content)
+{
+    if (text.size() < 2 || text.front() != '{' || text.back() != '}') { return false; }
+    content = text.substr(1, text.size() - 2);
+    return true;
+}
+
+} // namespace
+
+void BrokerAdapter::handleInput(const std::string& input)
+{
+    // sender >> message
+    std::string_view line = input;
+    size_t separator = line.find(" >> ");
+    if (separator != std::string_view::npos && separator > 0 && separator + 4 < line.size() && line.find_first_of(" \t") == separator) {
+        std::string_view sender = line.substr(0, separator);
+        std::string_view message = line.substr(separator + 4);
+        if (sender != broker_ || !handleBrokerMessage(message)) {
+            if (!handleExtendedMessage(std::string(message), std::string(sender))) {
+                _log << "ignore message '" << message << "' from " << sender << std::endl;
             }
         }
 
@@ -363,6 +230,189 @@ void BrokerAdapter::handleInput(const std::string& input)
     }
 }
 
+bool BrokerAdapter::handleBrokerMessage(std::string_view message)
+{
+    // messages from the broker are tokenized in place and dispatched on their first two words,
+    // a message in none of these formats is left to handleExtendedMessage
+    std::string_view args = message;
+    std::string_view verb = takeWord(args);
+    std::string_view target = takeWord(args);
+    bool accepted = (verb == "accept" || verb == "confirm");
+    if ((verb == "accept" || verb == "reject") && target == "request") {
+        // (accept|reject) request [id] [{command}]
+        size_t id_end = std::min(args.find_first_not_of("0123456789"), args.size());
+        std::string_view id_text = args.substr(0, id_end);
+        args.remove_prefix(id_end);
+        if (!args.empty() && args.front() == ' ') { args.remove_prefix(1); }
+        std::string_view command;
+        if (!args.empty() && (!parseBraced(args, command) || command.empty())) { return false; }
+        JobID id = NullJobID;
+        if (accepted) { parseNumber(id_text, id); }
+
+        std::function<bool(std::shared_ptr<Job>)> match_request = [](auto) { return false; };
+        if (command.size()) { // a new job (requested without id) has been accepted or rejected
+            match_request = [&](std::shared_ptr<Job> job) { return job->command_ == command && job->id_ == NullJobID; };
+        } else if (id != NullJobID) { // an accepted job with rejected result has been accepted again
+            match_request = [=](std::shared_ptr<Job> job) { return job->id_ == id; };
+        }
+
+        std::shared_ptr<Job> job;
+        {
+            std::scoped_lock lock(unconfirmed_mutex_);
+            auto it = std::find_if(unconfirmed_.begin(), unconfirmed_.end(), match_request);
+            if (it != unconfirmed_.end()) {
+                job = *it;
+                unconfirmed_.erase(it);
+            }
+        }
+        if (job) {
+            job->id_ = id;
+            job->state_ = JobState::JobConfirmed;
+            if (accepted) {
+                accepted_.insert({id, job});
+            }
+            onJobConfirmed(job, accepted);
+            _log << "confirm " << verb << "ed request " << id << " {" << command << "}" << std::endl;
+
+            notifyAllWaits();
+
+        } else {
+            _log << "ignore the confirmation of nonexistent request " << id << " {" << command << "}" << std::endl;
+        }
+
+    } else if (verb == "response") {
+        // response id code {output}
+        JobID id = NullJobID;
+        size_t output_begin = args.find(" {");
+        if (!parseNumber(target, id) || output_begin == 0 || output_begin == std::string_view::npos || args.back() != '}') { return false; }
+        std::string_view code = args.substr(0, output_begin);
+        std::string_view output = args.substr(output_begin + 2, args.size() - output_begin - 3);
+
+        std::shared_ptr<Job> job;
+        auto it = accepted_.find(id);
+        if (it != accepted_.end()) {
+            job = it->second;
+            accepted_.erase(it);
+        }
+        if (job) {
+            int code_value = -1;
+            if (parseNumber(code, code_value)) {
+                job->code_ = code_value;
+                job->output_ = output;
+                job->state_ = JobState::JobCompleted;
+            } else {
+                job->code_ = -1;
+                job->output_ = code;
+                job->state_ = JobState::JobTerminated;
+            }
+            bool accept = onJobCompleted(job);
+            if (!accept) {
+                std::scoped_lock lock(unconfirmed_mutex_);
+                job->state_ = JobState::JobUnconfirmed;
+                unconfirmed_.push_back(job);
+            }
+            std::string confirm = accept ? "accept" : "reject";
+            outputAsync(confirm + " response " + std::to_string(id));
+            _log << confirm << " response " << id << " " << code << " {" << output << "}" << std::endl;
+
+            notifyAllWaits();
+
+        } else {
+            _log << "ignore the response of nonexistent request " << id << std::endl;
+        }
+
+    } else if (verb == "notify" && target == "state") {
+        // notify state (idle|busy|full) [loading/capacity [details]]
+        std::string_view state = takeWord(args);
+        if (state != "idle" && state != "busy" && state != "full") { return false; }
+        size_t loading = 0, capacity = 0;
+        std::string_view details;
+        if (!args.empty()) {
+            std::string_view counts = takeWord(args);
+            size_t slash = counts.find('/');
+            if (slash == std::string_view::npos || !parseNumber(counts.substr(0, slash), loading) || !parseNumber(counts.substr(slash + 1), capacity)) { return false; }
+            details = args;
+        }
+        onStateChanged(std::string(state), loading, capacity, std::string(details));
+        _log << "confirm " << broker_ << " state " << state << " " << loading << "/" << capacity << " " << details << std::endl;
+
+    } else if (verb == "notify" && target == "assign") {
+        // notify assign request id to worker
+        JobID id = NullJobID;
+        if (takeWord(args) != "request" || !parseNumber(takeWord(args), id) || takeWord(args) != "to" || args.empty() || args.find(' ') != std::string_view::npos) { return false; }
+        std::string_view worker = args;
+
+        std::shared_ptr<Job> job;
+        auto it = accepted_.find(id);
+        if (it != accepted_.end()) {
+            job = it->second;
+        }
+        if (job) {
+            job->output_ = worker;
+            job->state_ = JobState::JobAssigned;
+            onJobAssigned(job, job->output_);
+            _log << "confirm request " << id << " assigned to worker " << worker << std::endl;
+
+            notifyAllWaits();
+
+        } else {
+            _log << "ignore the confirmation of nonexistent request " << id << " assigned to worker " << worker << std::endl;
+        }
+
+    } else if (verb == "notify" && target == "capacity") {
+        // notify capacity capacity [details]
+        size_t capacity = 0;
+        if (!parseNumber(takeWord(args), capacity)) { return false; }
+        std::string_view details = args;
+        onCapacityChanged(capacity, std::string(details));
+        _log << "confirm capacity " << capacity << " with '" << details << "'" << std::endl;
+
+    } else if ((accepted || verb == "reject") && target == "terminate") {
+        // (accept|confirm|reject) terminate id
+        JobID id = NullJobID;
+        if (!parseNumber(args, id)) { return false; }
+        if (!accepted) { id = NullJobID; }
+
+        std::shared_ptr<Job> job;
+        auto it = accepted_.find(id);
+        if (it != accepted_.end()) {
+            job = it->second;
+            accepted_.erase(it);
+        }
+        if (job) {
+            job->code_ = -1;
+            job->output_ = "terminate";
+            job->state_ = JobState::JobTerminated;
+            bool accept = onJobCompleted(job);
+            if (!accept) {
+                _log << "job terminated by client can not be enqueued again" << std::endl;
+            }
+            _log << "confirm " << verb << "ed terminate request " << id << std::endl;
+
+            notifyAllWaits();
+        }
+
+    } else if ((verb == "accept" || verb == "reject") && target == "protocol" && !args.empty()) {
+        // (accept|reject) protocol version
+        if (accepted) {
+            _log << "handshake with " << broker_ << " successfully" << std::endl;
+
+            for (const std::string& item : listSubscribedItems()) {
+                outputAsync("subscribe " + item);
+            }
+            onHandshakeCompleted();
+
+            notifyAllWaits();
+        } else {
+            handleHandshakeError(std::string(message));
+        }
+
+    } else /* message does not match any watched formats */ {
+        return false;
+    }
+    return true;
+}
+
 void BrokerAdapter::handleReadError(error_code ec, size_t n)
 {
     if (ec == boost::asio::error::eof || ec == boost::asio::error::operation_aborted) {
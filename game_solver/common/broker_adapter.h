@@ -8,6 +8,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <utility>
@@ -78,6 +79,8 @@ protected:
 
     virtual void onCapacityChanged(size_t capacity, const std::string& details) {}
 
+    virtual void onHandshakeCompleted() {}
+
     virtual void onNetworkError(const std::string& msg) {}
 
 protected:
@@ -118,6 +121,9 @@ protected:
 
     void notifyAllWaits();
 
+private:
+    bool handleBrokerMessage(std::string_view message);
+
 public:
     void log(const std::string& msg) const;
 
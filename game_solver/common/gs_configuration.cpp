@@ -19,6 +19,15 @@ bool use_ghi_check = true;
 bool use_timer_in_tt = false;
 bool log_solver_sgf = false;
 std::string solver_output_directory = "result";
+bool use_async_inference = false;
+int actor_num_inflight_leaves = 4;
+float solver_job_aging_rate = 0.0f;
+int worker_memory_budget_mb = 0;
+int solver_tree_summary_depth = 0;
+int solver_split_nodes = 0;
+std::string solved_position_db_file = "";
+int solved_position_db_bits = 20;
+float solver_split_time = 0.0f;
 
 // manager parameters
 bool use_online_fine_tuning = false;
@@ -33,6 +42,19 @@ bool use_solved_positions = false;
 float manager_solved_positions_ratio = 0.1;
 std::string manager_job_sgf = "(;FF[4]CA[UTF-8]SZ[7];B[dc];W[];B[de];W[df];B[ce])";
 std::string tree_file_name = "tree_manager";
+int manager_nn_batch_size = 1;
+float manager_job_budget_scale = 0.0f;
+int manager_job_max_nodes = 0;
+float manager_job_time_limit = 0.0f;
+int manager_max_job_results_per_step = 0;
+float manager_target_job_time = 0.0f;
+float manager_target_utilization = 0.9f;
+bool manager_merge_transposed_jobs = true;
+bool manager_use_transpositions = false;
+std::string manager_checkpoint_file = "";
+int manager_checkpoint_interval = 600;
+bool manager_resume_checkpoint = false;
+std::string manager_tree_file = "";
 
 // broker parameters
 bool use_broker = false;
@@ -44,6 +66,12 @@ bool broker_logging = false;
 
 // network parameters
 float nn_board_evaluation_scalar = 20.0;
+bool nn_use_cpu_engine = false;
+std::string nn_quantization = "none";
+int nn_inference_max_batch_size = 256;
+int nn_inference_timeout_us = 500;
+bool use_pcn_cache = false;
+int pcn_cache_size = 1 << 20;
 
 // actor parameters
 bool actor_use_random_op = true;
@@ -73,6 +101,15 @@ void setConfiguration(config::ConfigureLoader& cl)
     cl.addParameter("log_solver_sgf", log_solver_sgf, "true for logging the solution tree when the search is done", "Solver");
     cl.addParameter("solver_output_directory", solver_output_directory, "where the solution tree are stored", "Solver");
     cl.addParameter("use_ghi_check", use_ghi_check, "true for checking GHI problems in rzone", "Solver");
+    cl.addParameter("use_async_inference", use_async_inference, "true for evaluating leaves through the batching inference service instead of in lockstep", "Solver");
+    cl.addParameter("actor_num_inflight_leaves", actor_num_inflight_leaves, "maximum number of leaves a solver keeps waiting for evaluation in async inference", "Solver");
+    cl.addParameter("solver_job_aging_rate", solver_job_aging_rate, "queued jobs start in ascending priority (the pcn value unless given), which drops by this amount per second of waiting; 0 disables aging", "Solver");
+    cl.addParameter("worker_memory_budget_mb", worker_memory_budget_mb, "memory for the search data of all solvers on a worker (MB), new jobs start only if their estimated size fits; 0 for no limit", "Solver");
+    cl.addParameter("solver_tree_summary_depth", solver_tree_summary_depth, "number of plies of an unsolved job's tree returned to the manager for grafting, 0 for none", "Solver");
+    cl.addParameter("solver_split_nodes", solver_split_nodes, "split a job into sub-jobs for the manager after this many simulations, 0 for never", "Solver");
+    cl.addParameter("solver_split_time", solver_split_time, "split a job into sub-jobs for the manager after this many seconds, 0 for never", "Solver");
+    cl.addParameter("solved_position_db_file", solved_position_db_file, "memory-mapped file of solved positions kept across runs, empty for none", "Solver");
+    cl.addParameter("solved_position_db_bits", solved_position_db_bits, "a new solved position file holds 2^bits positions", "Solver");
 
     // manager pararmeters
     cl.addParameter("use_online_fine_tuning", use_online_fine_tuning, "", "Manager");
@@ -87,6 +124,19 @@ void setConfiguration(config::ConfigureLoader& cl)
     cl.addParameter("manager_solved_positions_ratio", manager_solved_positions_ratio, "", "Manager");
     cl.addParameter("manager_job_sgf", manager_job_sgf, "", "Manager");
     cl.addParameter("tree_file_name", tree_file_name, "", "Manager");
+    cl.addParameter("manager_nn_batch_size", manager_nn_batch_size, "number of leaves the manager selects under virtual loss and evaluates in one forward", "Manager");
+    cl.addParameter("manager_job_budget_scale", manager_job_budget_scale, "node budget of a job = scale * average nodes of finished jobs with similar pcn values; 0 for the workers' actor_num_simulation", "Manager");
+    cl.addParameter("manager_job_max_nodes", manager_job_max_nodes, "upper bound of job node budgets, may exceed the workers' actor_num_simulation; 0 for actor_num_simulation", "Manager");
+    cl.addParameter("manager_job_time_limit", manager_job_time_limit, "time limit of a job in seconds, 0 for no limit", "Manager");
+    cl.addParameter("manager_max_job_results_per_step", manager_max_job_results_per_step, "maximum number of job results integrated between two leaf evaluations, 0 for all pending results", "Manager");
+    cl.addParameter("manager_target_job_time", manager_target_job_time, "adjust manager_pcn_value_threshold online so that jobs take about this many seconds, 0 for a fixed threshold", "Manager");
+    cl.addParameter("manager_target_utilization", manager_target_utilization, "fraction of busy workers the adjusted threshold aims for", "Manager");
+    cl.addParameter("manager_merge_transposed_jobs", manager_merge_transposed_jobs, "true for letting leaves that reach the position of a running job wait for its result instead of sending another job", "Manager");
+    cl.addParameter("manager_use_transpositions", manager_use_transpositions, "true for starting leaves whose position is already searched in the tree from that node's statistics instead of sending them as jobs", "Manager");
+    cl.addParameter("manager_checkpoint_file", manager_checkpoint_file, "file of the manager tree and its running jobs, saved periodically and when the search stops; empty for no checkpoint", "Manager");
+    cl.addParameter("manager_checkpoint_interval", manager_checkpoint_interval, "seconds between checkpoints, 0 for saving only when the search stops", "Manager");
+    cl.addParameter("manager_resume_checkpoint", manager_resume_checkpoint, "true for restoring the tree from manager_checkpoint_file and sending its running jobs again", "Manager");
+    cl.addParameter("manager_tree_file", manager_tree_file, "file the manager tree is mapped to so that cold nodes are paged out, allowing actor_num_simulation beyond memory; empty for keeping the tree in memory", "Manager");
 
     // broker parameters
     cl.addParameter("use_broker", use_broker, "", "Broker");
@@ -98,6 +148,12 @@ void setConfiguration(config::ConfigureLoader& cl)
 
     // network parameters
     cl.addParameter("nn_board_evaluation_scalar", nn_board_evaluation_scalar, "", "Network");
+    cl.addParameter("nn_use_cpu_engine", nn_use_cpu_engine, "true for running the network with the native CPU engine instead of libtorch", "Network");
+    cl.addParameter("nn_quantization", nn_quantization, "none/fp16/int8 (any other value is rejected), quantized modes run on the native CPU engine", "Network");
+    cl.addParameter("nn_inference_max_batch_size", nn_inference_max_batch_size, "the inference service flushes a batch once this many leaves are queued", "Network");
+    cl.addParameter("nn_inference_timeout_us", nn_inference_timeout_us, "the inference service flushes a non-full batch after waiting this long (microseconds)", "Network");
+    cl.addParameter("use_pcn_cache", use_pcn_cache, "true for sharing network outputs of the same position (up to symmetry) in the process", "Network");
+    cl.addParameter("pcn_cache_size", pcn_cache_size, "maximum number of positions kept in the network output cache", "Network");
 
     // actor parameters
     cl.addParameter("actor_use_random_op", actor_use_random_op, "", "Actor");
@@ -19,6 +19,15 @@ extern bool use_ghi_check;
 extern bool use_timer_in_tt;
 extern bool log_solver_sgf;
 extern std::string solver_output_directory;
+extern bool use_async_inference;
+extern int actor_num_inflight_leaves;
+extern float solver_job_aging_rate;
+extern int worker_memory_budget_mb;
+extern int solver_tree_summary_depth;
+extern int solver_split_nodes;
+extern std::string solved_position_db_file;
+extern int solved_position_db_bits;
+extern float solver_split_time;
 
 // manager parameters
 extern bool use_online_fine_tuning;
@@ -33,6 +42,19 @@ extern bool use_solved_positions;
 extern float manager_solved_positions_ratio;
 extern std::string manager_job_sgf;
 extern std::string tree_file_name;
+extern int manager_nn_batch_size;
+extern float manager_job_budget_scale;
+extern int manager_job_max_nodes;
+extern float manager_job_time_limit;
+extern int manager_max_job_results_per_step;
+extern float manager_target_job_time;
+extern float manager_target_utilization;
+extern bool manager_merge_transposed_jobs;
+extern bool manager_use_transpositions;
+extern std::string manager_checkpoint_file;
+extern int manager_checkpoint_interval;
+extern bool manager_resume_checkpoint;
+extern std::string manager_tree_file;
 
 // broker parameters
 extern bool use_broker;
@@ -44,6 +66,12 @@ extern bool broker_logging;
 
 // network parameters
 extern float nn_board_evaluation_scalar;
+extern bool nn_use_cpu_engine;
+extern std::string nn_quantization;
+extern int nn_inference_max_batch_size;
+extern int nn_inference_timeout_us;
+extern bool use_pcn_cache;
+extern int pcn_cache_size;
 
 // actor parameters
 extern bool actor_use_random_op;
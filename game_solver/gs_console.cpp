@@ -74,7 +74,7 @@ void Console::cmdBoardEvaluation(const std::vector<std::string>& args)
     if (!checkArgument(args, 1, 1)) { return; }
     std::shared_ptr<ProofCostNetworkOutput> pcn_output = networkForward();
     std::vector<float> board_evaluation;
-    board_evaluation.reserve(pcn_output->board_evaluation_.size());
+    board_evaluation.resize(pcn_output->board_evaluation_.size());
     for (size_t i = 0; i < pcn_output->board_evaluation_.size(); i++) {
         board_evaluation[i] = pcn_output->board_evaluation_[i] * 2 - 1;
     }
@@ -85,7 +85,7 @@ void Console::cmdPolicy(const std::vector<std::string>& args)
 {
     if (!checkArgument(args, 1, 1)) { return; }
     std::shared_ptr<ProofCostNetworkOutput> pcn_output = networkForward();
-    reply(console::ConsoleResponse::kSuccess, dboard(pcn_output->policy_));
+    reply(console::ConsoleResponse::kSuccess, dboard(std::vector<float>(pcn_output->policy_.begin(), pcn_output->policy_.end())));
 }
 
 void Console::cmdValue(const std::vector<std::string>& args)
@@ -1,16 +1,25 @@
 #include "gs_mode_handler.h"
 #include "gs_console.h"
+#include "gs_hashkey.h"
 #include "manager.h"
+#include "pcn_cache.h"
+#include "random.h"
+#include "solved_position_db.h"
 #include "solver_group.h"
 #include "trainer_server.h"
 #include "tree_logger.h"
-#include <string>
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace gamesolver {
 
 GSModeHandler::GSModeHandler()
 {
+    gamesolver::initialize();
     RegisterFunction("worker", this, &GSModeHandler::runWorker);
     RegisterFunction("manager", this, &GSModeHandler::runManager);
     RegisterFunction("solver_test", this, &GSModeHandler::runSolverTest);
@@ -53,6 +62,11 @@ void GSModeHandler::runManager()
 
     Manager manager(tree_node_size);
     manager.setNetwork(network);
+    std::shared_ptr<PCNInferenceService> inference_service;
+    if (gamesolver::use_async_inference) {
+        inference_service = std::make_shared<PCNInferenceService>(std::vector<std::shared_ptr<minizero::network::Network>>{network}, 1, gamesolver::nn_inference_max_batch_size, gamesolver::nn_inference_timeout_us);
+        manager.setInferenceService(inference_service, 0);
+    }
 
     SolverJob solver_job;
     solver_job.sgf_ = gamesolver::manager_job_sgf;
@@ -65,6 +79,8 @@ void GSModeHandler::runManager()
     std::stringstream timess;
     timess << "time: " << ((end_solving - start_solving).total_microseconds() / 1000000.f) << std::endl;
     std::cerr << timess.str();
+    if (gamesolver::use_pcn_cache) { std::cerr << PCNCache::instance().toString() << std::endl; }
+    if (SolvedPositionDB::instance().isOpen()) { std::cerr << SolvedPositionDB::instance().toString() << std::endl; }
 
     // save solution tree
     TreeLogger::saveTreeStringToFile(gamesolver::tree_file_name + ".sgf", manager.getEnvironment(), manager.getMCTS());
@@ -108,52 +124,104 @@ void GSModeHandler::runSolverTest()
 
 void GSModeHandler::runBenchmarker()
 {
-    // TODO: fix this (rockmanray)
-    // std::shared_ptr<solver::ProofCostNetwork> network = std::make_shared<solver::ProofCostNetwork>();
-    // network->loadModel(config::nn_file_name, 0);
-    // long long tree_node_size = static_cast<long long>(config::actor_num_simulation + 1) * network->getActionSize();
-    // solver::KillAllGoSolver solver(tree_node_size);
-    // solver.setNetwork(network);
-    // std::string dir = "problems/benchmark";
-    // std::string filename = "capture_irrelevant_block_2.sgf";
-    // minizero::utils::SGFLoader sgf_loader;
-    // sgf_loader.loadFromFile(dir + "/" + filename);
-    // const std::vector<std::pair<std::vector<std::string>, std::string>>& actions = sgf_loader.getActions();
-    // const Environment& env = solver.getEnvironment();
-    // if (sgf_loader.getTags().count("SZ") == 0) { return; }
-    // for (auto act : actions) {
-    //     Action action(act.first, stoi(sgf_loader.getTags().at("SZ")));
-    //     solver.act(action);
-    // }
+    // compare the native CPU engine (fp32 and quantized) against libtorch on random positions, then measure the throughput of all of them
+    std::vector<std::shared_ptr<ProofCostNetwork>> networks{std::make_shared<ProofCostNetwork>(false, PCNCpuEngine::Precision::kFP32)};
+    for (auto precision : {PCNCpuEngine::Precision::kFP32, PCNCpuEngine::Precision::kFP16, PCNCpuEngine::Precision::kINT8}) { networks.push_back(std::make_shared<ProofCostNetwork>(true, precision)); }
+    for (auto& network : networks) { network->loadModel(minizero::config::nn_file_name, 0); }
+    std::vector<std::vector<float>> positions = sampleRandomPositions(1024);
+
+    std::cerr << "cpu engine: " << (PCNCpuEngine::useAVX2() ? "avx2" : "scalar") << " kernels" << std::endl;
+    for (size_t i = 1; i < networks.size(); ++i) { std::cerr << getNetworkName(networks[i]) << " vs " << getNetworkName(networks[0]) << ": " << compareNetworkOutputs(networks[0], networks[i], positions) << std::endl; }
+    for (int batch_size : {1, 16, 256}) {
+        for (auto& network : networks) { std::cerr << getNetworkName(network) << " batch " << batch_size << ": " << measureThroughput(network, positions, batch_size) << " positions/sec" << std::endl; }
+    }
 
-    // cout << env.toString() << endl;
-    // env::go::GoBitboard child_bitboard;
-    // std::vector<int> child_rz_pos{1, 2, 3, 4, 8, 9, 10, 11, 16, 17, 18, 19, 24, 25, 26, 27, 32, 33};
-    // for (unsigned int i = 0; i < child_rz_pos.size(); ++i) { child_bitboard.set(child_rz_pos[i]); }
-    // cout << "Child RZone:" << endl;
-    // for (int i = 6; i >= 0; --i) {
-    //     for (int j = 0; j < 7; ++j) {
-    //         if (child_bitboard.test(i * 7 + j)) {
-    //             cout << "1 ";
-    //         } else {
-    //             cout << "0 ";
-    //         }
-    //     }
-    //     cout << "\n";
-    // }
-    // minizero::env::killallgo::KillAllGoAction win_action(37, minizero::env::Player::kPlayer2);
-    // env::go::GoBitboard parent_bitboard = solver::knowledge::KillAllGoRZone::getLoserRZoneBitboard(env, child_bitboard, minizero::env::Player::kPlayer1);
-    // cout << "Updated RZone:" << endl;
-    // for (int i = 6; i >= 0; --i) {
-    //     for (int j = 0; j < 7; ++j) {
-    //         if (parent_bitboard.test(i * 7 + j)) {
-    //             cout << "1 ";
-    //         } else {
-    //             cout << "0 ";
-    //         }
-    //     }
-    //     cout << "\n";
-    // }
+    // end-to-end solver speed on manager_job_sgf, bounded by actor_num_simulation
+    for (auto& network : networks) { std::cerr << getNetworkName(network) << " solver: " << measureSolverSpeed(network) << " nodes/sec" << std::endl; }
+}
+
+std::string GSModeHandler::getNetworkName(std::shared_ptr<ProofCostNetwork> network) const
+{
+    return (network->isUsingCpuEngine() ? "cpu engine " + PCNCpuEngine::precisionToString(network->getPrecision()) : "libtorch");
+}
+
+float GSModeHandler::measureSolverSpeed(std::shared_ptr<ProofCostNetwork> network) const
+{
+    uint64_t tree_node_size = static_cast<uint64_t>(minizero::config::actor_num_simulation + 1) * network->getActionSize();
+    Solver solver(tree_node_size);
+    solver.setNetwork(network);
+    SolverJob solver_job;
+    solver_job.sgf_ = gamesolver::manager_job_sgf;
+    solver.setSolverJob(solver_job);
+
+    boost::posix_time::ptime start = minizero::utils::TimeSystem::getLocalTime();
+    solver.solve();
+    boost::posix_time::ptime end = minizero::utils::TimeSystem::getLocalTime();
+    return solver.getMCTS()->getRootNode()->getCount() / ((end - start).total_microseconds() / 1000000.0f);
+}
+
+std::vector<std::vector<float>> GSModeHandler::sampleRandomPositions(int num_positions) const
+{
+    // positions from random playouts of random lengths from the empty board
+    std::vector<std::vector<float>> positions;
+    Environment env;
+    while (static_cast<int>(positions.size()) < num_positions) {
+        env.reset();
+        int length = minizero::utils::Random::randInt() % (env.getBoardSize() * env.getBoardSize());
+        for (int i = 0; i < length && !env.isTerminal(); ++i) {
+            std::vector<Action> legal_actions = env.getLegalActions();
+            env.act(legal_actions[minizero::utils::Random::randInt() % legal_actions.size()]);
+        }
+        positions.push_back(env.getFeatures());
+    }
+    return positions;
+}
+
+std::string GSModeHandler::compareNetworkOutputs(std::shared_ptr<ProofCostNetwork> reference_network, std::shared_ptr<ProofCostNetwork> network, const std::vector<std::vector<float>>& positions) const
+{
+    float max_policy_error = 0.0f, max_board_evaluation_error = 0.0f, max_value_n_error = 0.0f, max_value_m_error = 0.0f;
+    double sum_value_n_error = 0.0;
+    int num_argmax_agreements = 0;
+    for (size_t start = 0; start < positions.size(); start += ProofCostNetwork::getMaxBatchSize()) {
+        size_t end = std::min(positions.size(), start + ProofCostNetwork::getMaxBatchSize());
+        for (size_t i = start; i < end; ++i) { reference_network->pushBack(positions[i]); }
+        for (size_t i = start; i < end; ++i) { network->pushBack(positions[i]); }
+        std::vector<std::shared_ptr<minizero::network::NetworkOutput>> reference_outputs = reference_network->forward();
+        std::vector<std::shared_ptr<minizero::network::NetworkOutput>> outputs = network->forward();
+        for (size_t i = 0; i < reference_outputs.size(); ++i) {
+            std::shared_ptr<ProofCostNetworkOutput> reference_output = std::static_pointer_cast<ProofCostNetworkOutput>(reference_outputs[i]);
+            std::shared_ptr<ProofCostNetworkOutput> output = std::static_pointer_cast<ProofCostNetworkOutput>(outputs[i]);
+            for (size_t action_id = 0; action_id < output->policy_.size(); ++action_id) { max_policy_error = std::max(max_policy_error, std::fabs(output->policy_[action_id] - reference_output->policy_[action_id])); }
+            for (size_t pos = 0; pos < output->board_evaluation_.size(); ++pos) { max_board_evaluation_error = std::max(max_board_evaluation_error, std::fabs(output->board_evaluation_[pos] - reference_output->board_evaluation_[pos])); }
+            max_value_n_error = std::max(max_value_n_error, std::fabs(output->value_n_ - reference_output->value_n_));
+            max_value_m_error = std::max(max_value_m_error, std::fabs(output->value_m_ - reference_output->value_m_));
+            sum_value_n_error += std::fabs(output->value_n_ - reference_output->value_n_);
+            if (std::max_element(output->policy_.begin(), output->policy_.end()) - output->policy_.begin() == std::max_element(reference_output->policy_.begin(), reference_output->policy_.end()) - reference_output->policy_.begin()) { ++num_argmax_agreements; }
+        }
+    }
+
+    std::ostringstream oss;
+    oss << "positions: " << positions.size()
+        << ", policy argmax agreement: " << static_cast<float>(num_argmax_agreements) / positions.size()
+        << ", max policy error: " << max_policy_error
+        << ", max board evaluation error: " << max_board_evaluation_error
+        << ", max value_n error: " << max_value_n_error
+        << ", mean value_n error: " << sum_value_n_error / positions.size()
+        << ", max value_m error: " << max_value_m_error;
+    return oss.str();
+}
+
+float GSModeHandler::measureThroughput(std::shared_ptr<ProofCostNetwork> network, const std::vector<std::vector<float>>& positions, int batch_size) const
+{
+    batch_size = std::min(batch_size, ProofCostNetwork::getMaxBatchSize());
+    const int num_positions = std::max(static_cast<int>(positions.size()), batch_size * 32);
+    boost::posix_time::ptime start = minizero::utils::TimeSystem::getLocalTime();
+    for (int i = 0; i < num_positions; i += batch_size) {
+        for (int j = 0; j < batch_size; ++j) { network->pushBack(positions[(i + j) % positions.size()]); }
+        network->forward();
+    }
+    boost::posix_time::ptime end = minizero::utils::TimeSystem::getLocalTime();
+    return num_positions / ((end - start).total_microseconds() / 1000000.0f);
 }
 
 } // namespace gamesolver
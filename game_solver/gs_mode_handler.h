@@ -2,6 +2,10 @@
 
 #include "gs_configuration.h"
 #include "mode_handler.h"
+#include "proof_cost_network.h"
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace gamesolver {
 
@@ -18,6 +22,12 @@ protected:
     void runManager();
     void runSolverTest();
     void runBenchmarker();
+
+    std::vector<std::vector<float>> sampleRandomPositions(int num_positions) const;
+    std::string compareNetworkOutputs(std::shared_ptr<ProofCostNetwork> reference_network, std::shared_ptr<ProofCostNetwork> network, const std::vector<std::vector<float>>& positions) const;
+    float measureThroughput(std::shared_ptr<ProofCostNetwork> network, const std::vector<std::vector<float>>& positions, int batch_size) const;
+    float measureSolverSpeed(std::shared_ptr<ProofCostNetwork> network) const;
+    std::string getNetworkName(std::shared_ptr<ProofCostNetwork> network) const;
 };
 
 } // namespace gamesolver
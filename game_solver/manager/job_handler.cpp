@@ -1,6 +1,7 @@
 #include "job_handler.h"
 #include "gs_configuration.h"
 #include <boost/format.hpp>
+#include <chrono>
 
 namespace gamesolver {
 
@@ -120,6 +121,7 @@ bool JobHandler::onJobCompleted(std::shared_ptr<BrokerAdapter::Job> job)
             return false;
         }
         job_package->owner_->pushJobResult(solver_job);
+        notifyEvent();
         return true;
 
     } else if (state == JobState::JobTerminated) {
@@ -158,13 +160,32 @@ void JobHandler::onStateChanged(const std::string& state, size_t loading, size_t
 {
     num_loading_ = loading;
     num_solvers_ = capacity;
+    notifyEvent();
+}
+
+void JobHandler::waitForEvent(uint64_t num_seen_events, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(event_mutex_);
+    event_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, num_seen_events] { return num_events_ != num_seen_events; });
+}
+
+void JobHandler::notifyEvent()
+{
+    {
+        std::scoped_lock lock(event_mutex_);
+        ++num_events_;
+    }
+    event_cv_.notify_all();
 }
 
 void JobHandler::onNetworkError(const std::string& msg)
 {
+    // the manager stops and saves its checkpoint, a restart with manager_resume_checkpoint continues the search
+    log("network error: " + msg);
     num_solvers_ = 0;
     num_loading_ = 0;
-    std::exit(1); // TODO: recover from network errors?
+    pushCommand("quit");
+    notifyEvent();
 }
 
 } // namespace gamesolver
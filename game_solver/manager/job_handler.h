@@ -3,6 +3,8 @@
 #include "broker_adapter.h"
 #include "gs_mcts.h"
 #include "solver_job.h"
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <memory>
 #include <mutex>
@@ -46,9 +48,15 @@ public:
     inline int getNumJobs() const { return id_job_map_.size(); }
     inline int getNumSolvers() const { return num_solvers_; }
     inline bool hasIdleSolvers() const { return num_loading_ < num_solvers_; }
+    inline float getUtilization() const { return (num_solvers_ > 0 ? static_cast<float>(num_loading_) / num_solvers_ : 0.0f); }
+
+    // events are job results and broker state changes; callers keep the count they have seen to avoid missed wake-ups
+    inline uint64_t getNumEvents() const { return num_events_; }
+    void waitForEvent(uint64_t num_seen_events, int timeout_ms);
 
 private:
     void initialize();
+    void notifyEvent();
 
 private: // override from chat::BrokerAdapter
     bool onJobCompleted(std::shared_ptr<BrokerAdapter::Job> job) override;
@@ -72,6 +80,9 @@ private:
     std::mutex job_map_mutex_;
     std::unordered_map<BrokerAdapter::JobID, std::shared_ptr<JobPackage>> id_job_map_;
     std::unordered_map<minizero::actor::MCTSNode*, std::shared_ptr<JobPackage>> node_job_map_;
+    std::atomic<uint64_t> num_events_ = 0;
+    std::mutex event_mutex_;
+    std::condition_variable event_cv_;
 };
 
 } // namespace gamesolver
@@ -1,15 +1,52 @@
 #include "manager.h"
 #include "gs_configuration.h"
 #include "sgf_loader.h"
+#include "solved_position_db.h"
 #include "utils.h"
 #include <algorithm>
-#include <boost/thread.hpp>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <unistd.h>
 
 namespace gamesolver {
 
 using namespace minizero;
 using namespace minizero::actor;
 
+// writes the content to a temporary file and renames it over the file, with both the data and the rename
+// flushed to disk, so that a crash or power loss leaves either the old or the new file
+static bool replaceFileDurably(const std::string& file_name, const std::string& content)
+{
+    std::string tmp_file_name = file_name + ".tmp";
+    int fd = ::open(tmp_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { return false; }
+    for (size_t written = 0; written < content.size();) {
+        ssize_t size = ::write(fd, content.data() + written, content.size() - written);
+        if (size < 0) {
+            ::close(fd);
+            return false;
+        }
+        written += size;
+    }
+    if (fsync(fd) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (::close(fd) != 0 || std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0) { return false; }
+
+    size_t slash = file_name.find_last_of('/');
+    std::string directory = (slash == std::string::npos ? "." : (slash == 0 ? "/" : file_name.substr(0, slash)));
+    int directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directory_fd < 0) { return false; }
+    bool is_synced = (fsync(directory_fd) == 0);
+    ::close(directory_fd);
+    return is_synced;
+}
+
 void Manager::reset()
 {
     BaseSolver::reset();
@@ -22,21 +59,105 @@ void Manager::resetSearch()
     BaseSolver::resetSearch();
     JobResultDeque::clear();
     recent_selection_path_.reset();
+    inflight_jobs_.clear();
+    inflight_job_keys_.clear();
+    num_inflight_jobs_.clear();
+    split_jobs_.clear();
+    pending_jobs_.clear();
+    transpositions_.clear();
+    job_threshold_controller_.reset();
+    last_checkpoint_time_ = std::chrono::steady_clock::now();
 }
 
 void Manager::solve()
 {
     resetSearch();
+    if (gamesolver::manager_resume_checkpoint && loadCheckpoint()) { job_handler_.log("resume from " + gamesolver::manager_checkpoint_file); }
+    std::vector<InflightLeaf> leaves;
+    std::vector<std::shared_ptr<network::NetworkOutput>> cached_outputs;
     while (!isSearchDone()) {
-        beforeNNEvaluation();
-        std::shared_ptr<network::NetworkOutput> network_output = ((pcn_network_->getBatchSize() > 0) ? pcn_network_->forward()[getNNEvaluationBatchIndex()] : nullptr);
-        afterNNEvaluation(network_output);
+        if (inference_service_) {
+            stepPipelined();
+            handleJobCommands();
+            broadcastCriticalPositions();
+            if (isCheckpointDue()) { saveCheckpoint(); }
+            continue;
+        }
+
+        selectLeaves(leaves, cached_outputs);
+        std::vector<std::shared_ptr<network::NetworkOutput>> network_outputs;
+        if (pcn_network_->getBatchSize() > 0) { network_outputs = pcn_network_->forward(); }
+        for (size_t i = 0; i < leaves.size(); ++i) {
+            if (isSearchDone()) {
+                for (auto& node : leaves[i].node_path_) { node->removeVirtualLoss(); }
+                continue;
+            }
+            mcts_search_data_.node_path_ = leaves[i].node_path_;
+            pcn_cache_key_ = leaves[i].pcn_cache_key_;
+            pcn_cache_position_map_ = leaves[i].pcn_cache_position_map_;
+            cached_nn_output_ = cached_outputs[i];
+            afterNNEvaluation(cached_outputs[i] ? cached_outputs[i] : network_outputs[leaves[i].tag_]);
+        }
+        if (leaves.empty()) {
+            // every selectable leaf is waiting for a job, or the job queue is full: only a job event can change the tree
+            uint64_t num_seen_events = job_handler_.getNumEvents();
+            afterNNEvaluation(nullptr);
+            if (!isSearchDone()) { job_handler_.waitForEvent(num_seen_events, kMaxWaitForSolversMs); }
+        }
         handleJobCommands();
         broadcastCriticalPositions();
+        if (isCheckpointDue()) { saveCheckpoint(); }
     }
+    if (!gamesolver::manager_checkpoint_file.empty()) { saveCheckpoint(); }
     job_handler_.removeJobs(this);
 }
 
+void Manager::stepPipelined()
+{
+    // the network forward runs on the inference service while this thread, the only writer of the tree,
+    // keeps selecting leaves and integrating job results decoded by the job handler
+    uint64_t num_seen_events = job_handler_.getNumEvents();
+    stepAsync();
+    if (!isSearchDone()) { handleSolverJobResults(); }
+    if (isSearchDone()) { return; }
+
+    if (inflight_leaves_.empty()) {
+        // every selectable leaf is waiting for a job, or the job queue is full: only a job event can change the tree
+        job_handler_.waitForEvent(num_seen_events, kMaxWaitForSolversMs);
+    } else {
+        inference_service_->waitForCompletions(num_seen_inference_batches_, gamesolver::nn_inference_timeout_us);
+    }
+}
+
+void Manager::handleEvaluatedLeaf(const std::shared_ptr<network::NetworkOutput>& network_output)
+{
+    // afterNNEvaluation keeps the virtual loss on leaves sent as jobs
+    if (!isSearchDone()) {
+        afterNNEvaluation(network_output);
+    } else {
+        for (auto& node : mcts_search_data_.node_path_) { node->removeVirtualLoss(); }
+    }
+}
+
+void Manager::selectLeaves(std::vector<InflightLeaf>& leaves, std::vector<std::shared_ptr<network::NetworkOutput>>& cached_outputs)
+{
+    // collect up to manager_nn_batch_size leaves (at most a full network batch), the virtual loss on selected leaves spreads them over the tree
+    leaves.clear();
+    cached_outputs.clear();
+    while (static_cast<int>(leaves.size()) < getMaxInflightLeaves()) {
+        if (!selectLeaf()) { break; }
+
+        // the virtual loss is no longer enough to steer the selection elsewhere, stop before the leaf takes a batch slot
+        const MCTSNode* leaf = mcts_search_data_.node_path_.back();
+        if (std::any_of(leaves.begin(), leaves.end(), [leaf](const InflightLeaf& selected) { return selected.node_path_.back() == leaf; })) { break; }
+
+        pushLeaf();
+        for (auto& node : mcts_search_data_.node_path_) { node->addVirtualLoss(); }
+        leaves.emplace_back(getNNEvaluationBatchIndex(), mcts_search_data_.node_path_, pcn_cache_key_, pcn_cache_position_map_);
+        cached_outputs.push_back(getCachedNNOutput());
+    }
+}
+
 void Manager::beforeNNEvaluation()
 {
     BaseSolver::beforeNNEvaluation();
@@ -51,26 +172,127 @@ void Manager::afterNNEvaluation(const std::shared_ptr<network::NetworkOutput>& n
         const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
         Environment env_transition = getEnvironmentTransition(node_path);
         MCTSNode* leaf = node_path.back();
+        // only leaves that were evaluated count, not those selected again and dropped before taking a batch slot
+        if (gamesolver::use_online_fine_tuning && gamesolver::use_critical_positions && !env_transition.isTerminal()) { recent_selection_path_.addSelectionPath(node_path); }
+        GSHashKey position_key = (gamesolver::manager_use_transpositions ? knowledge_handler_->getPositionHashKey(env_transition) : 0);
+        const Transposition* transposition = (gamesolver::manager_use_transpositions ? findTransposition(position_key, leaf) : nullptr);
         if (static_cast<GSMCTSNode*>(leaf)->isVirtualSolved()) {
         } else if (!env_transition.isTerminal() &&
                    leaf->getCount() == 0 &&
+                   !transposition &&
                    (!gamesolver::manager_send_and_player_job || (gamesolver::manager_send_and_player_job && leaf->getAction().getPlayer() == env::charToPlayer(gamesolver::solved_player))) &&
-                   pcn_output->value_n_ < gamesolver::manager_pcn_value_threshold) {
-            while (!job_handler_.hasIdleSolvers()) {
-                handleSolverJobResults();
-                boost::this_thread::sleep(boost::posix_time::milliseconds(50));
-            }
-            addVirtualSolvedNode(leaf, (node_path.size() >= 2 ? node_path[node_path.size() - 2] : nullptr));
-            job_handler_.addJob(this, leaf, SolverJob(getSolverJobSgf(node_path), pcn_output->value_n_, node_path));
-            job_handler_.log(getMCTS()->getRootNode()->isVirtualSolved() ? "is_root_virtual_solved_1" : "is_root_virtual_solved_0");
+                   pcn_output->value_n_ < job_threshold_controller_.getThreshold()) {
+            if (!applySolvedPosition(node_path)) { queueJob(node_path, pcn_output->value_n_); }
+        } else if (transposition) {
+            // the position was already searched elsewhere in the tree, start from its statistics instead of the network value
+            std::shared_ptr<ProofCostNetworkOutput> transposition_output = pcn_output->clone();
+            transposition_output->value_n_ = std::max(0.0f, transposition->node_->getMean() - transposition->value_offset_);
+            cached_nn_output_ = transposition_output; // not a network output, keep it out of the cache
+            BaseSolver::afterNNEvaluation(transposition_output);
+            for (auto& node : node_path) { node->removeVirtualLoss(); }
         } else {
             BaseSolver::afterNNEvaluation(network_output);
             for (auto& node : node_path) { node->removeVirtualLoss(); }
+            if (gamesolver::manager_use_transpositions && !leaf->isLeaf()) { addTransposition(position_key, node_path); }
         }
     }
     if (!isSearchDone()) { handleSolverJobResults(); }
 }
 
+const Manager::Transposition* Manager::findTransposition(GSHashKey position_key, const MCTSNode* leaf) const
+{
+    // solved transpositions are found by the R-zone TT, and a running job is joined when the leaf is sent
+    auto it = transpositions_.find(position_key);
+    if (it == transpositions_.end()) { return nullptr; }
+    const GSMCTSNode* node = static_cast<const GSMCTSNode*>(it->second.node_);
+    if (node == leaf || node->getCount() == 0 || node->isSolved() || node->isVirtualSolved()) { return nullptr; }
+    return &it->second;
+}
+
+void Manager::addTransposition(GSHashKey position_key, const std::vector<MCTSNode*>& node_path)
+{
+    // the first expanded node of a position represents it, the offset is what backup adds to its values on the way to the root
+    if (transpositions_.count(position_key)) { return; }
+    float value_offset = 0.0f;
+    for (size_t i = 1; i < node_path.size(); ++i) {
+        if (node_path[i]->getAction().getPlayer() != env::charToPlayer(gamesolver::solved_player)) { value_offset += std::log10(config::nn_action_size); }
+    }
+    transpositions_[position_key] = Transposition{node_path.back(), value_offset};
+}
+
+void Manager::dispatchJob(const std::vector<MCTSNode*>& node_path, float pcn_value)
+{
+    // the node path is under virtual loss until the job result is handled
+    MCTSNode* leaf = node_path.back();
+    addVirtualSolvedNode(leaf, (node_path.size() >= 2 ? node_path[node_path.size() - 2] : nullptr));
+    // the position key is only needed to merge jobs, replaying the path for it is skipped otherwise
+    GSHashKey position_key = (gamesolver::manager_merge_transposed_jobs ? knowledge_handler_->getPositionHashKey(getEnvironmentTransition(node_path)) : 0);
+    if (gamesolver::manager_merge_transposed_jobs && attachInflightJob(node_path, position_key)) {
+        job_handler_.log("attach to running job");
+        return;
+    }
+
+    SolverJob solver_job(getSolverJobSgf(node_path), pcn_value, node_path);
+    solver_job.max_nodes_ = job_cost_history_.getNodeBudget(pcn_value);
+    solver_job.time_limit_ = gamesolver::manager_job_time_limit;
+    job_handler_.addJob(this, leaf, solver_job);
+    addInflightJob(node_path, position_key, pcn_value);
+    job_handler_.log(getMCTS()->getRootNode()->isVirtualSolved() ? "is_root_virtual_solved_1" : "is_root_virtual_solved_0");
+}
+
+bool Manager::applySolvedPosition(const std::vector<MCTSNode*>& node_path)
+{
+    // a position solved in an earlier run is handled as a job result without sending the job
+    if (!SolvedPositionDB::instance().isOpen()) { return false; }
+    SolverJob stored_result;
+    if (!SolvedPositionDB::instance().lookup(knowledge_handler_->getPositionHashKey(getEnvironmentTransition(node_path)), stored_result.solver_status_, stored_result.rzone_bitboard_)) { return false; }
+    job_handler_.log("solved position db hit");
+    handleSolverJobResult(stored_result, node_path);
+    return true;
+}
+
+void Manager::queueJob(const std::vector<MCTSNode*>& node_path, float pcn_value)
+{
+    // the leaf is reserved under virtual loss and virtual solved until an idle solver takes the job,
+    // so the selection goes on instead of waiting for the workers
+    addVirtualSolvedNode(node_path.back(), (node_path.size() >= 2 ? node_path[node_path.size() - 2] : nullptr));
+    pending_jobs_.push_back(SplitJob{node_path, pcn_value});
+    dispatchPendingJobs();
+}
+
+void Manager::dispatchPendingJobs()
+{
+    while (!pending_jobs_.empty() && job_handler_.hasIdleSolvers()) {
+        SplitJob pending_job = pending_jobs_.front();
+        pending_jobs_.pop_front();
+
+        // a job under a node solved while it was queued is dropped
+        const std::vector<MCTSNode*>& node_path = pending_job.node_path_;
+        if (std::any_of(node_path.begin(), node_path.end(), [](const MCTSNode* node) { return static_cast<const GSMCTSNode*>(node)->isSolved(); })) {
+            for (auto& node : node_path) { node->removeVirtualLoss(); }
+            static_cast<GSMCTSNode*>(node_path.back())->setVirtualSolved(false);
+            continue;
+        }
+        dispatchJob(node_path, pending_job.pcn_value_);
+    }
+}
+
+void Manager::dispatchSplitJobs()
+{
+    // sub-jobs of split jobs go out before new leaves are selected
+    while (!split_jobs_.empty() && job_handler_.hasIdleSolvers()) {
+        SplitJob split_job = split_jobs_.front();
+        split_jobs_.pop_front();
+
+        const std::vector<MCTSNode*>& node_path = split_job.node_path_;
+        MCTSNode* leaf = node_path.back();
+        if (!leaf->isLeaf() || static_cast<GSMCTSNode*>(leaf)->isVirtualSolved() || inflight_jobs_.count(leaf)) { continue; }
+        if (std::any_of(node_path.begin(), node_path.end(), [](const MCTSNode* node) { return static_cast<const GSMCTSNode*>(node)->isSolved(); })) { continue; }
+        for (auto& node : node_path) { node->addVirtualLoss(); }
+        if (!applySolvedPosition(node_path)) { dispatchJob(node_path, split_job.pcn_value_); }
+    }
+}
+
 void Manager::RecentSelectionPath::TrieNode::reset(const minizero::actor::MCTSNode* node)
 {
     count_ = 0;
@@ -125,6 +347,67 @@ std::string Manager::RecentSelectionPath::summarize(std::string& prefix, TrieNod
     return res;
 }
 
+void Manager::JobCostHistory::add(float pcn_value, int nodes)
+{
+    Bucket& bucket = buckets_[static_cast<int>(pcn_value)];
+    ++bucket.num_jobs_;
+    bucket.total_nodes_ += nodes;
+}
+
+int Manager::JobCostHistory::getNodeBudget(float pcn_value) const
+{
+    // 0 lets the worker use its default actor_num_simulation
+    if (gamesolver::manager_job_budget_scale <= 0.0f) { return 0; }
+    auto it = buckets_.find(static_cast<int>(pcn_value));
+    if (it == buckets_.end() || it->second.num_jobs_ < kMinNumJobs) { return 0; }
+
+    int max_nodes = (gamesolver::manager_job_max_nodes > 0 ? gamesolver::manager_job_max_nodes : config::actor_num_simulation);
+    float average_nodes = static_cast<float>(it->second.total_nodes_) / it->second.num_jobs_;
+    return std::max(1, std::min(max_nodes, static_cast<int>(gamesolver::manager_job_budget_scale * average_nodes)));
+}
+
+float Manager::JobCostHistory::getAverageNodes(int bucket_id) const
+{
+    // -1 until enough jobs have finished in the bucket
+    auto it = buckets_.find(bucket_id);
+    if (it == buckets_.end() || it->second.num_jobs_ < kMinNumJobs) { return -1.0f; }
+    return static_cast<float>(it->second.total_nodes_) / it->second.num_jobs_;
+}
+
+void Manager::JobThresholdController::reset()
+{
+    base_threshold_ = gamesolver::manager_pcn_value_threshold;
+    threshold_ = base_threshold_;
+    seconds_per_node_ = 0.0f;
+    utilization_ = 1.0f;
+    utilization_bias_ = 0.0f;
+}
+
+void Manager::JobThresholdController::addJobResult(int nodes, float seconds, float utilization, const JobCostHistory& history)
+{
+    if (gamesolver::manager_target_job_time <= 0.0f) { return; }
+
+    float seconds_per_node = seconds / std::max(1, nodes);
+    seconds_per_node_ = (seconds_per_node_ > 0.0f ? kDecay * seconds_per_node_ + (1.0f - kDecay) * seconds_per_node : seconds_per_node);
+    utilization_ = kDecay * utilization_ + (1.0f - kDecay) * utilization;
+    utilization_bias_ += kUtilizationGain * (gamesolver::manager_target_utilization - utilization_);
+    utilization_bias_ = std::max(-kMaxUtilizationBias, std::min(kMaxUtilizationBias, utilization_bias_));
+
+    // the largest pcn value whose jobs are expected to finish within the target time, leaves below it become jobs
+    const float max_threshold = config::nn_discrete_value_size;
+    float threshold = -1.0f;
+    for (int bucket_id = 0; bucket_id < config::nn_discrete_value_size; ++bucket_id) {
+        float average_nodes = history.getAverageNodes(bucket_id);
+        if (average_nodes >= 0.0f && average_nodes * seconds_per_node_ <= gamesolver::manager_target_job_time) { threshold = bucket_id + 1; }
+    }
+    if (threshold < 0.0f) {
+        // not enough finished jobs to estimate the cost of each pcn value yet, step towards the target time
+        threshold = base_threshold_ + (seconds > gamesolver::manager_target_job_time ? -kThresholdStep : kThresholdStep);
+    }
+    base_threshold_ = std::max(1.0f, std::min(max_threshold, threshold));
+    threshold_ = std::max(1.0f, std::min(max_threshold, base_threshold_ + utilization_bias_));
+}
+
 std::vector<MCTSNode*> Manager::selection()
 {
     MCTSNode* node = getMCTS()->getRootNode();
@@ -155,7 +438,6 @@ std::vector<MCTSNode*> Manager::selection()
             continue;
         }
     }
-    if (gamesolver::use_online_fine_tuning && gamesolver::use_critical_positions && !env_transition.isTerminal()) { recent_selection_path_.addSelectionPath(node_path); }
     return node_path;
 }
 
@@ -191,51 +473,180 @@ void Manager::addVirtualSolvedNode(minizero::actor::MCTSNode* child, minizero::a
     if (child->getAction().getPlayer() == env::charToPlayer(gamesolver::solved_player) && parent) { static_cast<GSMCTSNode*>(parent)->setVirtualSolved(true); }
 }
 
+void Manager::updateSolverStatus(SolverStatus status, std::vector<MCTSNode*> node_path, const GSBitboard& rzone_bitboard)
+{
+    BaseSolver::updateSolverStatus(status, node_path, rzone_bitboard);
+    terminateJobsUnderSolvedNodes(node_path);
+    for (auto it = node_path.rbegin(); it != node_path.rend() && static_cast<GSMCTSNode*>(*it)->isSolved(); ++it) { getMCTS()->adviseColdChildren(*it); }
+}
+
+void Manager::addInflightJob(const std::vector<MCTSNode*>& node_path, GSHashKey position_key, float pcn_value)
+{
+    InflightJob& job = inflight_jobs_[node_path.back()];
+    job.position_key_ = position_key;
+    job.pcn_value_ = pcn_value;
+    job.start_time_ = std::chrono::steady_clock::now();
+    job.node_paths_ = {node_path};
+    if (gamesolver::manager_merge_transposed_jobs) { inflight_job_keys_[position_key] = node_path.back(); }
+    for (const auto& node : node_path) { ++num_inflight_jobs_[node]; }
+}
+
+bool Manager::attachInflightJob(const std::vector<MCTSNode*>& node_path, GSHashKey position_key)
+{
+    // another move order that reaches the position of a running job waits for its result
+    auto key_it = inflight_job_keys_.find(position_key);
+    if (key_it == inflight_job_keys_.end()) { return false; }
+    inflight_jobs_[key_it->second].node_paths_.push_back(node_path);
+    for (const auto& node : node_path) { ++num_inflight_jobs_[node]; }
+    return true;
+}
+
+bool Manager::takeInflightJob(MCTSNode* leaf, InflightJob& job)
+{
+    auto it = inflight_jobs_.find(leaf);
+    if (it == inflight_jobs_.end()) { return false; }
+    job = it->second;
+    for (const auto& node_path : job.node_paths_) { releaseInflightJobPath(node_path); }
+    auto key_it = inflight_job_keys_.find(job.position_key_);
+    if (key_it != inflight_job_keys_.end() && key_it->second == leaf) { inflight_job_keys_.erase(key_it); }
+    inflight_jobs_.erase(it);
+    return true;
+}
+
+void Manager::releaseInflightJobPath(const std::vector<MCTSNode*>& node_path)
+{
+    for (const auto& node : node_path) {
+        if (--num_inflight_jobs_[node] == 0) { num_inflight_jobs_.erase(node); }
+    }
+}
+
+void Manager::terminateJobsUnderSolvedNodes(const std::vector<MCTSNode*>& node_path)
+{
+    // updateSolverStatus solves nodes along the path and, by pruneNodesOutsideRZone, siblings of nodes on the path
+    if (inflight_jobs_.empty()) { return; }
+    for (const auto& node : node_path) {
+        if (!num_inflight_jobs_.count(node)) { return; }
+        if (static_cast<GSMCTSNode*>(node)->isSolved()) {
+            terminateJobsUnder(node);
+            return;
+        }
+        for (int i = 0; i < node->getNumChildren(); ++i) {
+            const GSMCTSNode* child = static_cast<GSMCTSNode*>(node)->getChild(i);
+            if (child->isSolved() && num_inflight_jobs_.count(child)) { terminateJobsUnder(child); }
+        }
+    }
+}
+
+void Manager::terminateJobsUnder(const MCTSNode* node)
+{
+    for (auto it = inflight_jobs_.begin(); it != inflight_jobs_.end();) {
+        // stop waiting at the node paths under the solved node
+        std::vector<std::vector<MCTSNode*>>& node_paths = it->second.node_paths_;
+        auto waiting_end = std::partition(node_paths.begin(), node_paths.end(), [node](const std::vector<MCTSNode*>& node_path) {
+            return std::find(node_path.begin(), node_path.end(), node) == node_path.end();
+        });
+        for (auto path_it = waiting_end; path_it != node_paths.end(); ++path_it) {
+            MCTSNode* leaf = path_it->back();
+            int num_virtual_loss = leaf->getVirtualLoss();
+            for (const auto& path_node : *path_it) { path_node->removeVirtualLoss(num_virtual_loss); }
+            static_cast<GSMCTSNode*>(leaf)->setVirtualSolved(false);
+            releaseInflightJobPath(*path_it);
+        }
+        node_paths.erase(waiting_end, node_paths.end());
+
+        // a job that has already completed is not removed, its result finds no node path to update
+        MCTSNode* job_leaf = it->first;
+        if (node_paths.empty() && job_handler_.removeJob(this, job_leaf)) {
+            auto key_it = inflight_job_keys_.find(it->second.position_key_);
+            if (key_it != inflight_job_keys_.end() && key_it->second == job_leaf) { inflight_job_keys_.erase(key_it); }
+            it = inflight_jobs_.erase(it);
+            job_handler_.log("terminate job under solved node");
+        } else {
+            ++it;
+        }
+    }
+}
+
 void Manager::handleSolverJobResults()
 {
     SolverJob job_result;
     std::string solved_sgf_message = "";
-    while (popJobResult(job_result)) {
-        // remove virtual loss and virtual solved
-        const std::vector<minizero::actor::MCTSNode*>& node_path = job_result.node_path_;
-        int num_virtual_loss = node_path.back()->getVirtualLoss();
-        for (const auto& node : node_path) { node->removeVirtualLoss(num_virtual_loss); }
-        static_cast<GSMCTSNode*>(node_path.back())->setVirtualSolved(false);
+    // a burst of results is integrated over several steps so that job generation is not blocked
+    int num_results = 0;
+    while ((gamesolver::manager_max_job_results_per_step <= 0 || num_results++ < gamesolver::manager_max_job_results_per_step) && popJobResult(job_result)) {
+        if (!job_result.is_split_) { job_cost_history_.add(job_result.pcn_value_, job_result.nodes_); } // a split job stopped early
+        InflightJob job;
+        if (takeInflightJob(job_result.node_path_.back(), job)) {
+            float job_seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - job.start_time_).count();
+            job_threshold_controller_.addJobResult(job_result.nodes_, job_seconds, job_handler_.getUtilization(), job_cost_history_);
+        } else {
+            job.node_paths_ = {job_result.node_path_};
+        }
 
         // check: skip already solved?
         if (gamesolver::use_online_fine_tuning && gamesolver::use_solved_positions && job_result.solver_status_ != SolverStatus::kSolverUnknown) {
-            solved_sgf_message += " " + getSolverJobSgf(node_path);
+            solved_sgf_message += " " + getSolverJobSgf(job_result.node_path_);
         }
 
-        // check whether the job is already solved
-        bool is_already_solved = false;
-        for (const auto& node : node_path) {
-            if (!static_cast<GSMCTSNode*>(node)->isSolved()) { continue; }
-            is_already_solved = true;
-            break;
-        }
-        if (is_already_solved) { job_handler_.log("already solved"); }
-        if (is_already_solved) { continue; }
-
-        // update rzone
-        if (job_result.solver_status_ == SolverStatus::kSolverUnknown) { // returning job is unsolved
-            // TODO: expand?
-            getMCTS()->backup(node_path, gamesolver::manager_pcn_value_threshold);
-            for (const auto& node : node_path) { static_cast<GSMCTSNode*>(node)->setVirtualSolved(false); }
-            job_handler_.log("unsolved!");
-        } else {
-            int value = (((node_path.back()->getAction().getPlayer() != env::charToPlayer(gamesolver::solved_player) && job_result.solver_status_ == SolverStatus::kSolverLoss) ||
-                          (node_path.back()->getAction().getPlayer() == env::charToPlayer(gamesolver::solved_player) && job_result.solver_status_ == SolverStatus::kSolverWin))
-                             ? 0
-                             : config::nn_discrete_value_size);
-            if (value != 0) { job_handler_.log("black wins!"); }
-            getMCTS()->backup(node_path, value);
-            updateSolverStatus(job_result.solver_status_, node_path, job_result.rzone_bitboard_);
-            updateGHIData(job_result);
+        // the result is fanned out to every node path that reached the job position
+        for (const auto& node_path : job.node_paths_) {
+            if (node_path == job_result.node_path_ || job_result.ghi_data_.empty()) {
+                handleSolverJobResult(job_result, node_path);
+            } else {
+                // results involving GHI depend on the history of the job, not only on its position
+                SolverJob unsolved_result = job_result;
+                unsolved_result.solver_status_ = SolverStatus::kSolverUnknown;
+                unsolved_result.ghi_data_.reset();
+                unsolved_result.tree_summary_.clear();
+                unsolved_result.is_split_ = false;
+                handleSolverJobResult(unsolved_result, node_path);
+            }
         }
     }
     if (isSearchDone()) { handleSearchDone(); }
     if (!solved_sgf_message.empty()) { job_handler_.outputAsync("solver solved_sgf" + solved_sgf_message); }
+    if (!isSearchDone()) {
+        dispatchSplitJobs();
+        dispatchPendingJobs();
+    }
+}
+
+void Manager::handleSolverJobResult(SolverJob job_result, const std::vector<MCTSNode*>& node_path)
+{
+    job_result.node_path_ = node_path;
+
+    // remove virtual loss and virtual solved
+    int num_virtual_loss = node_path.back()->getVirtualLoss();
+    for (const auto& node : node_path) { node->removeVirtualLoss(num_virtual_loss); }
+    static_cast<GSMCTSNode*>(node_path.back())->setVirtualSolved(false);
+
+    // check whether the job is already solved
+    bool is_already_solved = false;
+    for (const auto& node : node_path) {
+        if (!static_cast<GSMCTSNode*>(node)->isSolved()) { continue; }
+        is_already_solved = true;
+        break;
+    }
+    if (is_already_solved) { job_handler_.log("already solved"); }
+    if (is_already_solved) { return; }
+
+    // update rzone
+    if (job_result.solver_status_ == SolverStatus::kSolverUnknown) { // returning job is unsolved
+        getMCTS()->backup(node_path, job_threshold_controller_.getThreshold());
+        for (const auto& node : node_path) { static_cast<GSMCTSNode*>(node)->setVirtualSolved(false); }
+        graftTreeSummary(job_result);
+        job_handler_.log("unsolved!");
+    } else {
+        int value = (((node_path.back()->getAction().getPlayer() != env::charToPlayer(gamesolver::solved_player) && job_result.solver_status_ == SolverStatus::kSolverLoss) ||
+                      (node_path.back()->getAction().getPlayer() == env::charToPlayer(gamesolver::solved_player) && job_result.solver_status_ == SolverStatus::kSolverWin))
+                         ? 0
+                         : config::nn_discrete_value_size);
+        if (value != 0) { job_handler_.log("black wins!"); }
+        getMCTS()->backup(node_path, value);
+        updateSolverStatus(job_result.solver_status_, node_path, job_result.rzone_bitboard_);
+        updateGHIData(job_result);
+        if (job_result.ghi_data_.empty()) { SolvedPositionDB::instance().store(knowledge_handler_->getPositionHashKey(getEnvironmentTransition(node_path)), job_result.solver_status_, job_result.rzone_bitboard_); }
+    }
 }
 
 void Manager::handleJobCommands()
@@ -246,7 +657,7 @@ void Manager::handleJobCommands()
             std::vector<std::string> args = utils::stringToVector(job_command);
             assert(args.size() == 2);
             config::nn_file_name = args[1];
-            pcn_network_->loadModel(config::nn_file_name, pcn_network_->getGPUID());
+            pcn_network_->loadModelAsync(config::nn_file_name);
         } else if (job_command.find("quit") == 0) {
             quit_ = true;
         }
@@ -282,6 +693,56 @@ void Manager::updateGHIData(const SolverJob& job_result)
     for (size_t index = start_loop_index; index < node_path.size(); ++index) { static_cast<GSMCTSNode*>(node_path[index])->setInLoop(true); }
 }
 
+void Manager::graftTreeSummary(const SolverJob& job_result)
+{
+    if (job_result.tree_summary_.empty()) { return; }
+    TreeSummary tree_summary;
+    if (!tree_summary.parseFromString(job_result.tree_summary_)) {
+        job_handler_.log("incorrect tree summary for job " + std::to_string(job_result.job_id_));
+        return;
+    }
+
+    // the worker's values are from the job's perspective, shift them as backup does for the nodes above the job
+    std::vector<MCTSNode*> node_path = job_result.node_path_;
+    float value_offset = 0.0f;
+    for (size_t i = 1; i < node_path.size(); ++i) {
+        if (node_path[i]->getAction().getPlayer() != env::charToPlayer(gamesolver::solved_player)) { value_offset += std::log10(config::nn_action_size); }
+    }
+    graftTreeSummaryChildren(node_path, tree_summary.getChildren(), value_offset, job_result.is_split_);
+}
+
+void Manager::graftTreeSummaryChildren(std::vector<MCTSNode*>& node_path, const std::vector<TreeSummary::Node>& summary_children, float value_offset, bool is_split)
+{
+    // the visits stay below the job node, ancestors keep their own counts
+    MCTSNode* node = node_path.back();
+    if (summary_children.empty() || !node->isLeaf() || static_cast<GSMCTSNode*>(node)->isSolved()) { return; }
+    if (getMCTS()->getNumUsedNodes() + summary_children.size() > tree_node_size_) { return; }
+    Environment env_transition = getEnvironmentTransition(node_path);
+    if (env_transition.isTerminal()) { return; }
+
+    std::vector<std::pair<Action, float>> action_policy;
+    for (const auto& summary_child : summary_children) { action_policy.emplace_back(Action(summary_child.action_id_, env_transition.getTurn()), summary_child.policy_); }
+    getMCTS()->expand(node, action_policy);
+
+    for (size_t i = 0; i < summary_children.size(); ++i) {
+        const TreeSummary::Node& summary_child = summary_children[i];
+        MCTSNode* child = node->getChild(i);
+        node_path.push_back(child);
+        if (summary_child.count_ > 0) {
+            float mean = std::max(0.0f, std::min(config::nn_discrete_value_size - 1.0f, summary_child.mean_ + value_offset));
+            getMCTS()->addStatistics(child, mean, summary_child.count_);
+        }
+        graftTreeSummaryChildren(node_path, summary_child.children_, value_offset, is_split);
+        if (summary_child.solver_status_ != SolverStatus::kSolverUnknown && !static_cast<GSMCTSNode*>(child)->isSolved() && !static_cast<GSMCTSNode*>(node)->isSolved()) {
+            updateSolverStatus(summary_child.solver_status_, node_path, summary_child.rzone_bitboard_);
+        } else if (is_split && child->isLeaf() && summary_child.count_ > 0 && summary_child.solver_status_ == SolverStatus::kSolverUnknown) {
+            // the explored frontier of a split job, unvisited children are left to the selection
+            split_jobs_.push_back(SplitJob{node_path, summary_child.value_});
+        }
+        node_path.pop_back();
+    }
+}
+
 void Manager::broadcastCriticalPositions()
 {
     if (!gamesolver::use_online_fine_tuning || !gamesolver::use_critical_positions) { return; }
@@ -293,4 +754,94 @@ void Manager::broadcastCriticalPositions()
     recent_selection_path_.reset();
 }
 
+bool Manager::isCheckpointDue() const
+{
+    if (gamesolver::manager_checkpoint_file.empty() || gamesolver::manager_checkpoint_interval <= 0) { return false; }
+    return (std::chrono::steady_clock::now() - last_checkpoint_time_ >= std::chrono::seconds(gamesolver::manager_checkpoint_interval));
+}
+
+void Manager::saveCheckpoint()
+{
+    // checkpoint format: header, root sgf, root count and mean, tree summary of the whole tree,
+    // then one line per running or queued job: pcn_value followed by the action ids from the root
+    last_checkpoint_time_ = std::chrono::steady_clock::now();
+    MCTSNode* root = getMCTS()->getRootNode();
+    std::ostringstream oss;
+    oss << kCheckpointHeader << std::endl
+        << getSolverJobSgf({root}) << std::endl
+        << root->getCount() << " " << root->getMean() << std::endl
+        << TreeSummary::summarize(*getMCTS(), std::numeric_limits<int>::max()) << std::endl;
+    auto save_job = [&oss](const std::vector<MCTSNode*>& node_path, float pcn_value) {
+        oss << pcn_value;
+        for (size_t i = 1; i < node_path.size(); ++i) { oss << " " << node_path[i]->getAction().getActionID(); }
+        oss << std::endl;
+    };
+    for (const auto& p : inflight_jobs_) {
+        if (!p.second.node_paths_.empty()) { save_job(p.second.node_paths_.front(), p.second.pcn_value_); }
+    }
+    for (const auto& split_job : split_jobs_) { save_job(split_job.node_path_, split_job.pcn_value_); }
+    for (const auto& pending_job : pending_jobs_) { save_job(pending_job.node_path_, pending_job.pcn_value_); }
+
+    // written aside and renamed, a crash while saving keeps the previous checkpoint
+    if (!replaceFileDurably(gamesolver::manager_checkpoint_file, oss.str())) {
+        job_handler_.log("failed to save checkpoint " + gamesolver::manager_checkpoint_file);
+        return;
+    }
+    job_handler_.log("save checkpoint " + gamesolver::manager_checkpoint_file);
+}
+
+bool Manager::loadCheckpoint()
+{
+    std::ifstream fin(gamesolver::manager_checkpoint_file);
+    if (!fin) { return false; }
+
+    std::string header, root_sgf, root_statistics, summary_string;
+    std::getline(fin, header);
+    std::getline(fin, root_sgf);
+    std::getline(fin, root_statistics);
+    std::getline(fin, summary_string);
+    MCTSNode* root = getMCTS()->getRootNode();
+    if (header != kCheckpointHeader || root_sgf != getSolverJobSgf({root})) {
+        job_handler_.log("checkpoint " + gamesolver::manager_checkpoint_file + " does not match the job");
+        return false;
+    }
+    TreeSummary tree_summary;
+    if (!tree_summary.parseFromString(summary_string)) {
+        job_handler_.log("incorrect tree summary in checkpoint " + gamesolver::manager_checkpoint_file);
+        return false;
+    }
+
+    // replaying the solved nodes rebuilds their R-zones and the TT; GHI solutions are not kept and are searched again
+    int root_count = 0;
+    float root_mean = 0.0f;
+    std::istringstream(root_statistics) >> root_count >> root_mean;
+    if (root_count > 0) { getMCTS()->addStatistics(root, root_mean, root_count); }
+    std::vector<MCTSNode*> node_path{root};
+    graftTreeSummaryChildren(node_path, tree_summary.getChildren(), 0.0f, false);
+
+    // jobs that were running are sent again before new leaves are selected
+    std::string line;
+    while (std::getline(fin, line)) {
+        std::istringstream iss(line);
+        float pcn_value = 0.0f;
+        if (!(iss >> pcn_value)) { continue; }
+        node_path = {root};
+        int action_id = 0;
+        while (!node_path.empty() && iss >> action_id) {
+            MCTSNode* node = node_path.back();
+            MCTSNode* child = nullptr;
+            for (int i = 0; i < node->getNumChildren() && !child; ++i) {
+                if (node->getChild(i)->getAction().getActionID() == action_id) { child = node->getChild(i); }
+            }
+            if (child) {
+                node_path.push_back(child);
+            } else {
+                node_path.clear();
+            }
+        }
+        if (node_path.size() >= 2) { split_jobs_.push_back(SplitJob{node_path, pcn_value}); }
+    }
+    return true;
+}
+
 } // namespace gamesolver
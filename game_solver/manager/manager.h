@@ -2,6 +2,11 @@
 
 #include "job_handler.h"
 #include "solver.h"
+#include "tree_summary.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -12,7 +17,7 @@ namespace gamesolver {
 class Manager : public Solver, protected JobResultDeque {
 public:
     Manager(uint64_t tree_node_size, JobHandler& handler = JobHandler::instance())
-        : Solver(tree_node_size), job_handler_(handler)
+        : Solver(tree_node_size), job_handler_(handler), num_seen_inference_batches_(0)
     {
     }
 
@@ -49,18 +54,118 @@ private:
         std::vector<TrieNode> nodes_;
     };
 
+    // node counts of finished jobs grouped by their pcn values, used to give new jobs a node budget
+    class JobCostHistory {
+    public:
+        void add(float pcn_value, int nodes);
+        int getNodeBudget(float pcn_value) const;
+        float getAverageNodes(int bucket_id) const;
+
+    private:
+        class Bucket {
+        public:
+            int num_jobs_ = 0;
+            uint64_t total_nodes_ = 0;
+        };
+
+        std::map<int, Bucket> buckets_;
+        const int kMinNumJobs = 8;
+    };
+
+    // adjusts the pcn value threshold of jobs online so that jobs take about manager_target_job_time seconds,
+    // and raises it while the workers are less utilized than manager_target_utilization
+    class JobThresholdController {
+    public:
+        JobThresholdController() { reset(); }
+        void reset();
+        void addJobResult(int nodes, float seconds, float utilization, const JobCostHistory& history);
+        inline float getThreshold() const { return threshold_; }
+
+    private:
+        float base_threshold_;
+        float threshold_;
+        float seconds_per_node_;
+        float utilization_;
+        float utilization_bias_;
+        const float kDecay = 0.9f;
+        const float kThresholdStep = 0.1f;
+        const float kUtilizationGain = 0.1f;
+        const float kMaxUtilizationBias = 2.0f;
+    };
+
+    // a job sent to workers, the first node path is the one it was sent from and the others reach the same position
+    class InflightJob {
+    public:
+        GSHashKey position_key_;
+        float pcn_value_;
+        std::chrono::steady_clock::time_point start_time_;
+        std::vector<std::vector<minizero::actor::MCTSNode*>> node_paths_;
+    };
+
+    class Transposition {
+    public:
+        minizero::actor::MCTSNode* node_;
+        float value_offset_;
+    };
+
+    class SplitJob {
+    public:
+        std::vector<minizero::actor::MCTSNode*> node_path_;
+        float pcn_value_;
+    };
+
+    std::shared_ptr<minizero::actor::Search> createSearch() override { return std::make_shared<GSMCTS>(tree_node_size_, gamesolver::manager_tree_file); }
+    void stepPipelined();
+    // no leaves are selected while the queue of jobs waiting for idle solvers is full
+    int getMaxInflightLeaves() const override { return (static_cast<int>(pending_jobs_.size()) >= std::max(1, job_handler_.getNumSolvers()) ? 0 : std::min(gamesolver::manager_nn_batch_size, ProofCostNetwork::getMaxBatchSize())); }
+    void handleEvaluatedLeaf(const std::shared_ptr<minizero::network::NetworkOutput>& network_output) override;
+    void selectLeaves(std::vector<InflightLeaf>& leaves, std::vector<std::shared_ptr<minizero::network::NetworkOutput>>& cached_outputs);
     std::vector<minizero::actor::MCTSNode*> selection() override;
     bool isValidSimulation(const GSMCTSNode* node, const std::vector<minizero::env::GamePair<GSBitboard>>& ancestor_positions) const override;
     void addVirtualSolvedNode(minizero::actor::MCTSNode* child, minizero::actor::MCTSNode* parent);
+    void updateSolverStatus(SolverStatus status, std::vector<minizero::actor::MCTSNode*> node_path, const GSBitboard& rzone_bitboard) override;
+    void addInflightJob(const std::vector<minizero::actor::MCTSNode*>& node_path, GSHashKey position_key, float pcn_value);
+    bool attachInflightJob(const std::vector<minizero::actor::MCTSNode*>& node_path, GSHashKey position_key);
+    bool takeInflightJob(minizero::actor::MCTSNode* leaf, InflightJob& job);
+    void releaseInflightJobPath(const std::vector<minizero::actor::MCTSNode*>& node_path);
+    void terminateJobsUnderSolvedNodes(const std::vector<minizero::actor::MCTSNode*>& node_path);
+    void terminateJobsUnder(const minizero::actor::MCTSNode* node);
     void handleSolverJobResults();
+    void handleSolverJobResult(SolverJob job_result, const std::vector<minizero::actor::MCTSNode*>& node_path);
     void handleJobCommands();
     std::string getSolverJobSgf(const std::vector<minizero::actor::MCTSNode*>& node_path);
     void updateGHIData(const SolverJob& job_result);
+    void graftTreeSummary(const SolverJob& job_result);
+    void graftTreeSummaryChildren(std::vector<minizero::actor::MCTSNode*>& node_path, const std::vector<TreeSummary::Node>& summary_children, float value_offset, bool is_split);
+    const Transposition* findTransposition(GSHashKey position_key, const minizero::actor::MCTSNode* leaf) const;
+    void addTransposition(GSHashKey position_key, const std::vector<minizero::actor::MCTSNode*>& node_path);
+    void dispatchJob(const std::vector<minizero::actor::MCTSNode*>& node_path, float pcn_value);
+    void queueJob(const std::vector<minizero::actor::MCTSNode*>& node_path, float pcn_value);
+    void dispatchPendingJobs();
+    void dispatchSplitJobs();
+    bool applySolvedPosition(const std::vector<minizero::actor::MCTSNode*>& node_path);
     void broadcastCriticalPositions();
+    bool isCheckpointDue() const;
+    void saveCheckpoint();
+    bool loadCheckpoint();
 
     bool quit_;
     JobHandler& job_handler_;
     RecentSelectionPath recent_selection_path_;
+    JobCostHistory job_cost_history_;
+    JobThresholdController job_threshold_controller_;
+    uint64_t num_seen_inference_batches_;
+    std::chrono::steady_clock::time_point last_checkpoint_time_;
+
+    // jobs sent to workers keyed by their leaves and by their positions, and the number of node paths waiting below each node
+    std::unordered_map<minizero::actor::MCTSNode*, InflightJob> inflight_jobs_;
+    std::unordered_map<GSHashKey, minizero::actor::MCTSNode*> inflight_job_keys_;
+    std::unordered_map<const minizero::actor::MCTSNode*, int> num_inflight_jobs_;
+    std::deque<SplitJob> split_jobs_;
+    std::deque<SplitJob> pending_jobs_;
+    std::unordered_map<GSHashKey, Transposition> transpositions_;
+    const int kMaxWaitForSolversMs = 1000; // only a fallback, job results and state changes wake up the manager
+    const std::string kCheckpointHeader = "gs_manager_checkpoint 1";
 };
 
 } // namespace gamesolver
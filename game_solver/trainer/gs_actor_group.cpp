@@ -2,6 +2,7 @@
 #include "gs_configuration.h"
 #include "utils.h"
 #include <algorithm>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <torch/cuda.h>
@@ -23,13 +24,20 @@ void GSSlaveThread::doGPUJob()
 
 void GSActorGroup::createNeuralNetworks()
 {
-    int num_networks = std::min(static_cast<int>(torch::cuda::device_count()), config::actor_num_parallel_games);
+    // the CPU engine runs one network per slave thread instead of one per GPU
+    bool use_cpu_engine = ProofCostNetwork::useCpuEngine();
+    int num_networks = std::min((use_cpu_engine ? config::actor_num_threads : static_cast<int>(torch::cuda::device_count())), config::actor_num_parallel_games);
     assert(num_networks > 0);
+    // in lockstep every actor pushes one position per step into its network's batch, the inference service bounds its own batches
+    if (!gamesolver::use_async_inference && config::actor_num_parallel_games > num_networks * ProofCostNetwork::getMaxBatchSize()) {
+        std::cerr << "actor_num_parallel_games is limited to " << num_networks * ProofCostNetwork::getMaxBatchSize() << " by the network batch size" << std::endl;
+        config::actor_num_parallel_games = num_networks * ProofCostNetwork::getMaxBatchSize();
+    }
     getSharedData()->networks_.resize(num_networks);
     getSharedData()->network_outputs_.resize(num_networks);
-    for (int gpu_id = 0; gpu_id < num_networks; ++gpu_id) {
-        getSharedData()->networks_[gpu_id] = std::make_shared<ProofCostNetwork>();
-        std::dynamic_pointer_cast<ProofCostNetwork>(getSharedData()->networks_[gpu_id])->loadModel(config::nn_file_name, gpu_id);
+    for (int network_id = 0; network_id < num_networks; ++network_id) {
+        getSharedData()->networks_[network_id] = std::make_shared<ProofCostNetwork>();
+        std::dynamic_pointer_cast<ProofCostNetwork>(getSharedData()->networks_[network_id])->loadModel(config::nn_file_name, (use_cpu_engine ? 0 : network_id));
     }
 }
 
@@ -64,6 +72,12 @@ void GSActorGroup::handleCommand(const std::string& command_prefix, const std::s
             std::shared_ptr<GSActor> actor = std::static_pointer_cast<GSActor>(getSharedData()->actors_[actor_id]);
             actor->setSgfOpenings(sgf_openings);
         }
+    } else if (command_prefix == "load_model") {
+        // keep the search running while the new model loads, each network switches at its next forward
+        std::vector<std::string> args = utils::stringToVector(command);
+        assert(args.size() == 2);
+        config::nn_file_name = args[1];
+        for (auto& network : getSharedData()->networks_) { std::static_pointer_cast<ProofCostNetwork>(network)->loadModelAsync(config::nn_file_name); }
     } else {
         ActorGroup::handleCommand(command_prefix, command);
     }
@@ -2,7 +2,13 @@
 #include "gs_configuration.h"
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
+#include <cstdint>
+#include <fcntl.h>
+#include <iostream>
 #include <limits>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <utility>
 
 namespace gamesolver {
@@ -110,6 +116,14 @@ std::string GHIData::toString() const
     return oss.str();
 }
 
+GSMCTS::~GSMCTS()
+{
+    // nodes only hold plain data, the mapping is released without destroying them one by one (which would page them all in)
+    if (mapped_size_ == 0) { return; }
+    munmap(nodes_, mapped_size_);
+    nodes_ = nullptr;
+}
+
 void GSMCTS::reset()
 {
     MCTS::reset();
@@ -140,6 +154,54 @@ void GSMCTS::backup(const std::vector<actor::MCTSNode*>& node_path, const float
     }
 }
 
+void GSMCTS::addStatistics(actor::MCTSNode* node, float mean, int count)
+{
+    // visits backed up elsewhere, the mean is from root's perspective as in backup
+    float original_mean = node->getMean();
+    node->add(mean, count);
+    updateTreeValueMap(original_mean, node->getMean());
+}
+
+void GSMCTS::adviseColdChildren(const actor::MCTSNode* node) const
+{
+    // a solved node is not selected again, its children may be written back and evicted before other nodes
+    if (mapped_size_ == 0 || node->getNumChildren() == 0) { return; }
+#ifdef MADV_COLD
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    const GSMCTSNode* first_child = static_cast<const GSMCTSNode*>(node->getChild(0));
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(first_child) + page_size - 1) & ~(page_size - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(first_child + node->getNumChildren()) & ~(page_size - 1);
+    if (begin < end) { madvise(reinterpret_cast<void*>(begin), end - begin, MADV_COLD); }
+#endif
+}
+
+actor::TreeNode* GSMCTS::createTreeNodes(uint64_t tree_node_size)
+{
+    if (!tree_file_name_.empty()) {
+        if (GSMCTSNode* nodes = createMappedTreeNodes(tree_node_size)) { return nodes; }
+        std::cerr << "failed to map tree file " << tree_file_name_ << ", allocate the tree in memory" << std::endl;
+    }
+    return new GSMCTSNode[tree_node_size];
+}
+
+GSMCTSNode* GSMCTS::createMappedTreeNodes(uint64_t tree_node_size)
+{
+    // the file is only backing storage for this run since nodes point to each other, its old content is discarded
+    int fd = open(tree_file_name_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { return nullptr; }
+    size_t mapped_size = tree_node_size * sizeof(GSMCTSNode);
+    void* mapped = MAP_FAILED;
+    if (ftruncate(fd, mapped_size) == 0) { mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); }
+    close(fd);
+    if (mapped == MAP_FAILED) { return nullptr; }
+
+    madvise(mapped, mapped_size, MADV_RANDOM);
+    GSMCTSNode* nodes = static_cast<GSMCTSNode*>(mapped);
+    for (uint64_t i = 0; i < tree_node_size; ++i) { new (&nodes[i]) GSMCTSNode(); }
+    mapped_size_ = mapped_size;
+    return nodes;
+}
+
 minizero::actor::MCTSNode* GSMCTS::selectChildByPUCTScore(const minizero::actor::MCTSNode* node, int top_k_selection, bool skip_virtual_solved_nodes) const
 {
     assert(node && !node->isLeaf() && top_k_selection > 0);
@@ -102,11 +102,14 @@ typedef minizero::actor::TreeData<GHIData> TreeGHIData;
 
 class GSMCTS : public minizero::actor::MCTS {
 public:
-    GSMCTS(uint64_t tree_node_size)
-        : minizero::actor::MCTS(tree_node_size) {}
+    GSMCTS(uint64_t tree_node_size, const std::string& tree_file_name = "")
+        : minizero::actor::MCTS(tree_node_size), tree_file_name_(tree_file_name), mapped_size_(0) {}
+    ~GSMCTS();
 
     void reset() override;
     void backup(const std::vector<minizero::actor::MCTSNode*>& node_path, const float value, const float reward = 0.0f) override;
+    void addStatistics(minizero::actor::MCTSNode* node, float mean, int count);
+    void adviseColdChildren(const minizero::actor::MCTSNode* node) const;
     minizero::actor::MCTSNode* selectChildByPUCTScore(const minizero::actor::MCTSNode* node) const override { return selectChildByPUCTScore(node, 1, false); }
     virtual minizero::actor::MCTSNode* selectChildByPUCTScore(const minizero::actor::MCTSNode* node, int top_k_selection, bool skip_virtual_solved_nodes) const;
     minizero::actor::MCTSNode* selectChildByRandomOpening(const minizero::actor::MCTSNode* node) const;
@@ -118,15 +121,22 @@ public:
     inline TreeGHIData& getTreeGHIData() { return tree_ghi_data_; }
     inline const TreeGHIData& getTreeGHIData() const { return tree_ghi_data_; }
     inline std::unordered_map<GSMCTSNode*, int>& getGHINodeMap() { return ghi_nodes_map_; }
+    inline const std::unordered_map<GSMCTSNode*, int>& getGHINodeMap() const { return ghi_nodes_map_; }
+    inline uint64_t getNumUsedNodes() const { return current_tree_size_; }
     inline void addGHINodes(GSMCTSNode* node, int loop_above_offset) { ghi_nodes_map_.insert({node, loop_above_offset}); }
 
 protected:
-    minizero::actor::TreeNode* createTreeNodes(uint64_t tree_node_size) override { return new GSMCTSNode[tree_node_size]; }
+    minizero::actor::TreeNode* createTreeNodes(uint64_t tree_node_size) override;
+    GSMCTSNode* createMappedTreeNodes(uint64_t tree_node_size);
     minizero::actor::TreeNode* getNodeIndex(int index) override { return getRootNode() + index; }
 
     TreeRZoneData tree_rzone_data_;
     TreeGHIData tree_ghi_data_;
     std::unordered_map<GSMCTSNode*, int> ghi_nodes_map_;
+
+    // nodes in a file mapping instead of the heap, the kernel pages cold nodes out to the file
+    std::string tree_file_name_;
+    size_t mapped_size_;
 };
 
 } // namespace gamesolver
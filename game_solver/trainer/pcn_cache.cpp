@@ -0,0 +1,140 @@
+#include "pcn_cache.h"
+#include "gs_configuration.h"
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace gamesolver {
+
+using namespace minizero;
+
+PCNCache& PCNCache::instance()
+{
+    static PCNCache cache;
+    return cache;
+}
+
+PCNCache::PCNCache()
+    : shard_capacity_(std::max(1, gamesolver::pcn_cache_size >> kShardBits)),
+      num_hits_(0),
+      num_misses_(0)
+{
+}
+
+std::shared_ptr<ProofCostNetworkOutput> PCNCache::lookup(GSHashKey key, const std::vector<int>& position_map, uint64_t model_version)
+{
+    std::shared_ptr<ProofCostNetworkOutput> canonical_output;
+    {
+        Shard& shard = getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        auto it = shard.index_.find(key);
+        if (it != shard.index_.end()) {
+            if (it->second->model_version_ == model_version) {
+                shard.entries_.splice(shard.entries_.begin(), shard.entries_, it->second);
+                canonical_output = it->second->output_;
+            } else {
+                shard.entries_.erase(it->second);
+                shard.index_.erase(it);
+            }
+        }
+    }
+
+    if (!canonical_output) {
+        ++num_misses_;
+        return nullptr;
+    }
+    ++num_hits_;
+    return remap(*canonical_output, position_map, false);
+}
+
+void PCNCache::store(GSHashKey key, const std::vector<int>& position_map, const ProofCostNetworkOutput& output)
+{
+    std::shared_ptr<ProofCostNetworkOutput> canonical_output = remap(output, position_map, true);
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    auto it = shard.index_.find(key);
+    if (it != shard.index_.end()) {
+        it->second->model_version_ = output.model_version_;
+        it->second->output_ = canonical_output;
+        shard.entries_.splice(shard.entries_.begin(), shard.entries_, it->second);
+        return;
+    }
+
+    shard.entries_.emplace_front(key, output.model_version_, canonical_output);
+    shard.index_[key] = shard.entries_.begin();
+    if (shard.entries_.size() > shard_capacity_) {
+        shard.index_.erase(shard.entries_.back().key_);
+        shard.entries_.pop_back();
+    }
+}
+
+void PCNCache::clear()
+{
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        shard.entries_.clear();
+        shard.index_.clear();
+    }
+    num_hits_ = num_misses_ = 0;
+}
+
+GSHashKey PCNCache::getCanonicalHashKey(const env::GamePair<GSBitboard>& stone_bitboard, env::Player turn, int ko_position, int board_size, const std::vector<utils::Rotation>& symmetries, std::vector<int>& position_map)
+{
+    assert(!symmetries.empty());
+    GSHashKey canonical_key = 0;
+    utils::Rotation canonical_rotation = symmetries[0];
+    for (size_t i = 0; i < symmetries.size(); ++i) {
+        GSHashKey key = (turn == env::Player::kPlayer2 ? turn_hash_key : 0);
+        if (ko_position != -1) { key ^= getPlayerHashKey(utils::getPositionByRotating(symmetries[i], ko_position, board_size), env::Player::kPlayerNone); }
+        for (env::Player player : {env::Player::kPlayer1, env::Player::kPlayer2}) {
+            GSBitboard bitboard = stone_bitboard.get(player);
+            while (!bitboard.none()) {
+                int pos = bitboard._Find_first();
+                bitboard.reset(pos);
+                key ^= getPlayerHashKey(utils::getPositionByRotating(symmetries[i], pos, board_size), player);
+            }
+        }
+        if (i > 0 && key >= canonical_key) { continue; }
+        canonical_key = key;
+        canonical_rotation = symmetries[i];
+    }
+
+    position_map.resize(board_size * board_size);
+    for (int pos = 0; pos < board_size * board_size; ++pos) { position_map[pos] = utils::getPositionByRotating(canonical_rotation, pos, board_size); }
+    return canonical_key;
+}
+
+std::string PCNCache::toString() const
+{
+    std::ostringstream oss;
+    oss << "pcn cache hits: " << getNumHits() << ", misses: " << getNumMisses() << ", hit rate: " << getHitRate();
+    return oss.str();
+}
+
+std::shared_ptr<ProofCostNetworkOutput> PCNCache::remap(const ProofCostNetworkOutput& output, const std::vector<int>& position_map, bool to_canonical)
+{
+    // positions outside the board (e.g., pass) keep their index
+    const int policy_size = output.policy_.size();
+    const int num_positions = position_map.size();
+    auto getMappedPosition = [&](int pos) { return (pos < num_positions ? position_map[pos] : pos); };
+
+    std::vector<float> row(ProofCostNetworkOutput::getRowSize(policy_size));
+    for (int pos = 0; pos < policy_size; ++pos) {
+        const int from = (to_canonical ? pos : getMappedPosition(pos));
+        const int to = (to_canonical ? getMappedPosition(pos) : pos);
+        row[to] = output.policy_[from];
+        row[policy_size + to] = output.policy_logits_[from];
+    }
+    const int board_evaluation_size = output.board_evaluation_.size();
+    for (int pos = 0; pos < board_evaluation_size; ++pos) {
+        const int mapped_pos = (num_positions <= board_evaluation_size ? getMappedPosition(pos) : pos);
+        row[2 * policy_size + (to_canonical ? mapped_pos : pos)] = output.board_evaluation_[to_canonical ? pos : mapped_pos];
+    }
+    row[3 * policy_size - 1] = output.value_n_;
+    row[3 * policy_size] = output.value_m_;
+    return ProofCostNetworkOutput::create(std::move(row), policy_size);
+}
+
+} // namespace gamesolver
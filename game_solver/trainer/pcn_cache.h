@@ -0,0 +1,68 @@
+#pragma once
+
+#include "base_env.h"
+#include "gs_bitboard.h"
+#include "gs_hashkey.h"
+#include "proof_cost_network.h"
+#include "rotation.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gamesolver {
+
+// Process-wide LRU cache of network outputs. Positions are keyed by their stones, turn and ko point after canonicalizing
+// over the board symmetries, outputs are stored in the canonical orientation and rotated back on lookup.
+// Each entry keeps the version of the model that produced it and only a network running that model reads it.
+class PCNCache {
+public:
+    static PCNCache& instance();
+
+    std::shared_ptr<ProofCostNetworkOutput> lookup(GSHashKey key, const std::vector<int>& position_map, uint64_t model_version);
+    void store(GSHashKey key, const std::vector<int>& position_map, const ProofCostNetworkOutput& output);
+    void clear();
+
+    static GSHashKey getCanonicalHashKey(const minizero::env::GamePair<GSBitboard>& stone_bitboard, minizero::env::Player turn, int ko_position, int board_size, const std::vector<minizero::utils::Rotation>& symmetries, std::vector<int>& position_map);
+
+    inline uint64_t getNumHits() const { return num_hits_; }
+    inline uint64_t getNumMisses() const { return num_misses_; }
+    inline float getHitRate() const { return (num_hits_ + num_misses_ == 0 ? 0.0f : static_cast<float>(num_hits_) / (num_hits_ + num_misses_)); }
+    std::string toString() const;
+
+private:
+    class Entry {
+    public:
+        Entry(GSHashKey key, uint64_t model_version, const std::shared_ptr<ProofCostNetworkOutput>& output)
+            : key_(key), model_version_(model_version), output_(output) {}
+
+        GSHashKey key_;
+        uint64_t model_version_;
+        std::shared_ptr<ProofCostNetworkOutput> output_;
+    };
+
+    class Shard {
+    public:
+        std::mutex mutex_;
+        std::list<Entry> entries_; // most recently used first
+        std::unordered_map<GSHashKey, std::list<Entry>::iterator> index_;
+    };
+
+    PCNCache();
+
+    inline Shard& getShard(GSHashKey key) { return shards_[key >> (64 - kShardBits)]; }
+    static std::shared_ptr<ProofCostNetworkOutput> remap(const ProofCostNetworkOutput& output, const std::vector<int>& position_map, bool to_canonical);
+
+    static constexpr int kShardBits = 6;
+    std::array<Shard, 1 << kShardBits> shards_;
+    size_t shard_capacity_;
+    std::atomic<uint64_t> num_hits_;
+    std::atomic<uint64_t> num_misses_;
+};
+
+} // namespace gamesolver
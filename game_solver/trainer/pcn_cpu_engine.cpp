@@ -0,0 +1,466 @@
+#include "pcn_cpu_engine.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace gamesolver {
+
+namespace {
+
+const float kBatchNormEpsilon = 1e-5;
+
+// c[m][n] = bias[m] + sum_k a[m][k] * b[k][n]
+void gemmScalar(const float* a, const float* b, const float* bias, float* c, int m, int k, int n)
+{
+    for (int i = 0; i < m; ++i) {
+        float* c_row = c + i * n;
+        std::fill(c_row, c_row + n, bias[i]);
+        for (int kk = 0; kk < k; ++kk) {
+            const float a_value = a[i * k + kk];
+            const float* b_row = b + kk * n;
+            for (int j = 0; j < n; ++j) { c_row[j] += a_value * b_row[j]; }
+        }
+    }
+}
+
+float dotScalar(const float* a, const float* b, int size)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < size; ++i) { sum += a[i] * b[i]; }
+    return sum;
+}
+
+// IEEE half <-> float conversions for the scalar path, rounding to nearest even
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff) { return sign | 0x7c00 | (mantissa ? 0x200 : 0); } // inf or nan
+    if (exponent >= 31) { return sign | 0x7c00; }
+    if (exponent <= 0) {
+        if (exponent < -10) { return sign; }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half_mantissa = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) { ++half_mantissa; }
+        return sign | half_mantissa;
+    }
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) { ++half; }
+    return half;
+}
+
+float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    int exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // subnormal half, normalize it
+            exponent = 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | static_cast<uint32_t>(exponent - 15 + 127) << 23 | ((mantissa & 0x3ff) << 13);
+        }
+    } else {
+        bits = sign | static_cast<uint32_t>(exponent - 15 + 127) << 23 | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+float dotFP16Scalar(const uint16_t* a, const float* b, int size)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < size; ++i) { sum += halfToFloat(a[i]) * b[i]; }
+    return sum;
+}
+
+int32_t dotINT8Scalar(const int8_t* a, const int8_t* b, int size)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < size; ++i) { sum += static_cast<int32_t>(a[i]) * b[i]; }
+    return sum;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2,fma"))) void gemmAVX2(const float* a, const float* b, const float* bias, float* c, int m, int k, int n)
+{
+    const int vector_n = n - n % 8;
+    for (int i = 0; i < m; ++i) {
+        const float* a_row = a + i * k;
+        float* c_row = c + i * n;
+        for (int j = 0; j < vector_n; j += 8) {
+            __m256 sum = _mm256_set1_ps(bias[i]);
+            for (int kk = 0; kk < k; ++kk) { sum = _mm256_fmadd_ps(_mm256_set1_ps(a_row[kk]), _mm256_loadu_ps(b + kk * n + j), sum); }
+            _mm256_storeu_ps(c_row + j, sum);
+        }
+        for (int j = vector_n; j < n; ++j) {
+            float sum = bias[i];
+            for (int kk = 0; kk < k; ++kk) { sum += a_row[kk] * b[kk * n + j]; }
+            c_row[j] = sum;
+        }
+    }
+}
+
+__attribute__((target("avx2,fma"))) float dotAVX2(const float* a, const float* b, int size)
+{
+    const int vector_size = size - size % 8;
+    __m256 sum = _mm256_setzero_ps();
+    for (int i = 0; i < vector_size; i += 8) { sum = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum); }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 0x55));
+    float result = _mm_cvtss_f32(half);
+    for (int i = vector_size; i < size; ++i) { result += a[i] * b[i]; }
+    return result;
+}
+
+__attribute__((target("avx2,fma,f16c"))) float dotFP16AVX2(const uint16_t* a, const float* b, int size)
+{
+    const int vector_size = size - size % 8;
+    __m256 sum = _mm256_setzero_ps();
+    for (int i = 0; i < vector_size; i += 8) {
+        __m256 weight = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        sum = _mm256_fmadd_ps(weight, _mm256_loadu_ps(b + i), sum);
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 0x55));
+    float result = _mm_cvtss_f32(half);
+    for (int i = vector_size; i < size; ++i) { result += halfToFloat(a[i]) * b[i]; }
+    return result;
+}
+
+__attribute__((target("avx2"))) int32_t dotINT8AVX2(const int8_t* a, const int8_t* b, int size)
+{
+    // widen to int16 and multiply-add pairs into int32, which cannot overflow for |x| <= 127
+    const int vector_size = size - size % 16;
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < vector_size; i += 16) {
+        __m256i a16 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b16 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a16, b16));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+    int32_t result = _mm_cvtsi128_si32(half);
+    for (int i = vector_size; i < size; ++i) { result += static_cast<int32_t>(a[i]) * b[i]; }
+    return result;
+}
+#endif
+
+class Kernels {
+public:
+    void (*gemm_)(const float*, const float*, const float*, float*, int, int, int);
+    float (*dot_)(const float*, const float*, int);
+    float (*dotFP16_)(const uint16_t*, const float*, int);
+    int32_t (*dotINT8_)(const int8_t*, const int8_t*, int);
+};
+
+// picked once for the running CPU, the function-local static makes it safe for engines loaded on several threads
+const Kernels& getKernels()
+{
+    static const Kernels kernels = []() {
+        Kernels kernels{gemmScalar, dotScalar, dotFP16Scalar, dotINT8Scalar};
+#if defined(__x86_64__)
+        if (PCNCpuEngine::useAVX2()) {
+            kernels.gemm_ = gemmAVX2;
+            kernels.dot_ = dotAVX2;
+            kernels.dotINT8_ = dotINT8AVX2;
+            if (__builtin_cpu_supports("f16c")) { kernels.dotFP16_ = dotFP16AVX2; }
+        }
+#endif
+        return kernels;
+    }();
+    return kernels;
+}
+
+inline void relu(float* data, int size)
+{
+    for (int i = 0; i < size; ++i) { data[i] = std::max(data[i], 0.0f); }
+}
+
+void softmax(const float* logits, float* output, int size)
+{
+    const float max_logit = *std::max_element(logits, logits + size);
+    float sum = 0.0f;
+    for (int i = 0; i < size; ++i) { sum += (output[i] = std::exp(logits[i] - max_logit)); }
+    for (int i = 0; i < size; ++i) { output[i] /= sum; }
+}
+
+} // namespace
+
+bool PCNCpuEngine::useAVX2()
+{
+#if defined(__x86_64__)
+    static const bool use_avx2 = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+    return use_avx2;
+#else
+    return false;
+#endif
+}
+
+PCNCpuEngine::Precision PCNCpuEngine::stringToPrecision(const std::string& precision)
+{
+    // nn_quantization goes through here in every mode that builds a network, an unknown mode must not fall back to fp32 silently
+    if (precision == "none" || precision == "fp32") { return Precision::kFP32; }
+    if (precision == "fp16") { return Precision::kFP16; }
+    if (precision == "int8") { return Precision::kINT8; }
+    std::cerr << "[PCNCpuEngine] unknown nn_quantization \"" << precision << "\", expected none/fp16/int8" << std::endl;
+    exit(-1);
+}
+
+std::string PCNCpuEngine::precisionToString(Precision precision)
+{
+    switch (precision) {
+        case Precision::kFP16: return "fp16";
+        case Precision::kINT8: return "int8";
+        default: return "fp32";
+    }
+}
+
+void PCNCpuEngine::load(torch::jit::script::Module& module, int num_input_channels, int channel_height, int channel_width)
+{
+    num_input_channels_ = num_input_channels;
+    channel_height_ = channel_height;
+    channel_width_ = channel_width;
+    tensors_.clear();
+    for (const auto& parameter : module.named_parameters()) { tensors_[parameter.name] = parameter.value.detach().to(torch::kCPU, torch::kFloat32).contiguous(); }
+    for (const auto& buffer : module.named_buffers()) { tensors_[buffer.name] = buffer.value.detach().to(torch::kCPU, torch::kFloat32).contiguous(); }
+
+    conv_ = loadConv("conv", "bn");
+    residual_blocks_.clear();
+    for (int block = 0; hasTensor("residual_blocks." + std::to_string(block) + ".conv1.weight"); ++block) {
+        const std::string prefix = "residual_blocks." + std::to_string(block) + ".";
+        residual_blocks_.emplace_back(loadConv(prefix + "conv1", prefix + "bn1"), loadConv(prefix + "conv2", prefix + "bn2"));
+    }
+    for (auto head : {std::make_pair(&policy_, std::string("policy")), std::make_pair(&value_n_, std::string("value_n")), std::make_pair(&value_m_, std::string("value_m"))}) {
+        head.first->conv_ = loadConv(head.second + ".conv", head.second + ".bn");
+        head.first->fc_ = loadLinear(head.second + ".fc");
+        quantize(head.first->fc_);
+    }
+    has_board_evaluation_ = hasTensor("board_evaluation.conv.weight");
+    if (has_board_evaluation_) { board_evaluation_ = loadConv("board_evaluation.conv", ""); }
+    tensors_.clear();
+
+    const int channel_size = channel_height_ * channel_width_;
+    const int max_channels = std::max({num_input_channels_, conv_.out_channels_, policy_.conv_.out_channels_, value_n_.conv_.out_channels_, value_m_.conv_.out_channels_});
+    hidden_.resize(conv_.out_channels_ * channel_size);
+    block_hidden_.resize(conv_.out_channels_ * channel_size);
+    block_output_.resize(conv_.out_channels_ * channel_size);
+    columns_.resize(max_channels * 9 * channel_size);
+    head_hidden_.resize(max_channels * channel_size);
+    logits_.resize(std::max(getActionSize(), getValueSize()));
+    int8_input_.resize(max_channels * channel_size);
+}
+
+void PCNCpuEngine::forward(const float* input, int batch_size, float* output)
+{
+    const int action_size = getActionSize();
+    const int value_size = getValueSize();
+    const int channel_size = channel_height_ * channel_width_;
+    const int row_size = 3 * action_size + 1;
+    const int input_size = num_input_channels_ * channel_size;
+    const int hidden_size = conv_.out_channels_ * channel_size;
+    for (int batch_index = 0; batch_index < batch_size; ++batch_index) {
+        const float* features = input + static_cast<int64_t>(batch_index) * input_size;
+        float* row = output + static_cast<int64_t>(batch_index) * row_size;
+
+        // trunk
+        conv(conv_, features, hidden_.data());
+        relu(hidden_.data(), hidden_size);
+        for (const auto& block : residual_blocks_) {
+            conv(block.first, hidden_.data(), block_hidden_.data());
+            relu(block_hidden_.data(), hidden_size);
+            conv(block.second, block_hidden_.data(), block_output_.data());
+            for (int i = 0; i < hidden_size; ++i) { hidden_[i] = std::max(hidden_[i] + block_output_[i], 0.0f); }
+        }
+
+        // policy: [policy | policy_logits]
+        forwardHead(policy_, hidden_.data(), row + action_size);
+        softmax(row + action_size, row, action_size);
+
+        // board evaluation
+        float* board_evaluation = row + 2 * action_size;
+        std::fill(board_evaluation, board_evaluation + action_size - 1, 0.0f);
+        if (has_board_evaluation_) {
+            conv(board_evaluation_, hidden_.data(), head_hidden_.data());
+            for (int i = 0; i < std::min(channel_size, action_size - 1); ++i) { board_evaluation[i] = 1.0f / (1.0f + std::exp(-head_hidden_[i])); }
+        }
+
+        // values
+        forwardHead(value_n_, hidden_.data(), logits_.data());
+        row[3 * action_size - 1] = getExpectation(logits_.data(), value_size);
+        forwardHead(value_m_, hidden_.data(), logits_.data());
+        row[3 * action_size] = getExpectation(logits_.data(), value_size);
+    }
+}
+
+PCNCpuEngine::ConvLayer PCNCpuEngine::loadConv(const std::string& conv_name, const std::string& bn_name) const
+{
+    torch::Tensor weight = getTensor(conv_name + ".weight");
+    ConvLayer layer;
+    layer.out_channels_ = weight.size(0);
+    layer.in_channels_ = weight.size(1);
+    layer.kernel_size_ = weight.size(2);
+    assert(layer.kernel_size_ == 1 || layer.kernel_size_ == 3);
+    const int weight_size = layer.in_channels_ * layer.kernel_size_ * layer.kernel_size_;
+    layer.weight_.assign(weight.data_ptr<float>(), weight.data_ptr<float>() + layer.out_channels_ * weight_size);
+    if (hasTensor(conv_name + ".bias")) {
+        torch::Tensor bias = getTensor(conv_name + ".bias");
+        layer.bias_.assign(bias.data_ptr<float>(), bias.data_ptr<float>() + layer.out_channels_);
+    } else {
+        layer.bias_.assign(layer.out_channels_, 0.0f);
+    }
+    if (bn_name.empty()) { return layer; }
+
+    // fold the batch norm: y = gamma * (x - mean) / sqrt(var + eps) + beta
+    const float* gamma = getTensor(bn_name + ".weight").data_ptr<float>();
+    const float* beta = getTensor(bn_name + ".bias").data_ptr<float>();
+    const float* mean = getTensor(bn_name + ".running_mean").data_ptr<float>();
+    const float* var = getTensor(bn_name + ".running_var").data_ptr<float>();
+    for (int out_channel = 0; out_channel < layer.out_channels_; ++out_channel) {
+        const float scale = gamma[out_channel] / std::sqrt(var[out_channel] + kBatchNormEpsilon);
+        for (int i = 0; i < weight_size; ++i) { layer.weight_[out_channel * weight_size + i] *= scale; }
+        layer.bias_[out_channel] = (layer.bias_[out_channel] - mean[out_channel]) * scale + beta[out_channel];
+    }
+    return layer;
+}
+
+PCNCpuEngine::LinearLayer PCNCpuEngine::loadLinear(const std::string& name) const
+{
+    torch::Tensor weight = getTensor(name + ".weight");
+    torch::Tensor bias = getTensor(name + ".bias");
+    LinearLayer layer;
+    layer.out_features_ = weight.size(0);
+    layer.in_features_ = weight.size(1);
+    layer.weight_.assign(weight.data_ptr<float>(), weight.data_ptr<float>() + layer.out_features_ * layer.in_features_);
+    layer.bias_.assign(bias.data_ptr<float>(), bias.data_ptr<float>() + layer.out_features_);
+    return layer;
+}
+
+torch::Tensor PCNCpuEngine::getTensor(const std::string& name) const
+{
+    auto it = tensors_.find(name);
+    if (it == tensors_.end()) {
+        std::cerr << "[PCNCpuEngine] missing parameter \"" << name << "\" in the loaded model" << std::endl;
+        exit(-1);
+    }
+    return it->second;
+}
+
+void PCNCpuEngine::conv(const ConvLayer& layer, const float* input, float* output)
+{
+    const int channel_size = channel_height_ * channel_width_;
+    if (layer.kernel_size_ == 1) {
+        getKernels().gemm_(layer.weight_.data(), input, layer.bias_.data(), output, layer.out_channels_, layer.in_channels_, channel_size);
+        return;
+    }
+
+    // im2col with zero padding, rows ordered as the [in_channel][ky][kx] weight layout
+    float* column = columns_.data();
+    for (int in_channel = 0; in_channel < layer.in_channels_; ++in_channel) {
+        const float* plane = input + in_channel * channel_size;
+        for (int ky = -1; ky <= 1; ++ky) {
+            for (int kx = -1; kx <= 1; ++kx) {
+                for (int y = 0; y < channel_height_; ++y) {
+                    const bool valid_y = (y + ky >= 0 && y + ky < channel_height_);
+                    for (int x = 0; x < channel_width_; ++x) {
+                        const bool valid_x = (x + kx >= 0 && x + kx < channel_width_);
+                        *column++ = (valid_y && valid_x ? plane[(y + ky) * channel_width_ + x + kx] : 0.0f);
+                    }
+                }
+            }
+        }
+    }
+    getKernels().gemm_(layer.weight_.data(), columns_.data(), layer.bias_.data(), output, layer.out_channels_, layer.in_channels_ * 9, channel_size);
+}
+
+void PCNCpuEngine::quantize(LinearLayer& layer) const
+{
+    if (precision_ == Precision::kFP16) {
+        layer.fp16_weight_.resize(layer.weight_.size());
+        std::transform(layer.weight_.begin(), layer.weight_.end(), layer.fp16_weight_.begin(), floatToHalf);
+        layer.weight_.clear();
+    } else if (precision_ == Precision::kINT8) {
+        // symmetric per output feature: w ~= scale * q, q in [-127, 127]
+        layer.int8_weight_.resize(layer.weight_.size());
+        layer.int8_weight_scale_.resize(layer.out_features_);
+        for (int out_feature = 0; out_feature < layer.out_features_; ++out_feature) {
+            const float* weight = layer.weight_.data() + static_cast<int64_t>(out_feature) * layer.in_features_;
+            float max_abs_weight = 0.0f;
+            for (int i = 0; i < layer.in_features_; ++i) { max_abs_weight = std::max(max_abs_weight, std::fabs(weight[i])); }
+            const float scale = (max_abs_weight > 0.0f ? max_abs_weight / 127.0f : 1.0f);
+            layer.int8_weight_scale_[out_feature] = scale;
+            for (int i = 0; i < layer.in_features_; ++i) { layer.int8_weight_[static_cast<int64_t>(out_feature) * layer.in_features_ + i] = static_cast<int8_t>(std::lround(weight[i] / scale)); }
+        }
+        layer.weight_.clear();
+    }
+}
+
+void PCNCpuEngine::linear(const LinearLayer& layer, const float* input, float* output)
+{
+    if (precision_ == Precision::kFP16) {
+        for (int out_feature = 0; out_feature < layer.out_features_; ++out_feature) {
+            output[out_feature] = layer.bias_[out_feature] + getKernels().dotFP16_(layer.fp16_weight_.data() + static_cast<int64_t>(out_feature) * layer.in_features_, input, layer.in_features_);
+        }
+    } else if (precision_ == Precision::kINT8) {
+        // dynamic activation scale, recomputed for every input
+        float max_abs_input = 0.0f;
+        for (int i = 0; i < layer.in_features_; ++i) { max_abs_input = std::max(max_abs_input, std::fabs(input[i])); }
+        const float input_scale = (max_abs_input > 0.0f ? max_abs_input / 127.0f : 1.0f);
+        for (int i = 0; i < layer.in_features_; ++i) { int8_input_[i] = static_cast<int8_t>(std::lround(input[i] / input_scale)); }
+        for (int out_feature = 0; out_feature < layer.out_features_; ++out_feature) {
+            const int32_t sum = getKernels().dotINT8_(layer.int8_weight_.data() + static_cast<int64_t>(out_feature) * layer.in_features_, int8_input_.data(), layer.in_features_);
+            output[out_feature] = layer.bias_[out_feature] + sum * layer.int8_weight_scale_[out_feature] * input_scale;
+        }
+    } else {
+        for (int out_feature = 0; out_feature < layer.out_features_; ++out_feature) {
+            output[out_feature] = layer.bias_[out_feature] + getKernels().dot_(layer.weight_.data() + static_cast<int64_t>(out_feature) * layer.in_features_, input, layer.in_features_);
+        }
+    }
+}
+
+void PCNCpuEngine::forwardHead(const Head& head, const float* input, float* logits)
+{
+    const int head_hidden_size = head.conv_.out_channels_ * channel_height_ * channel_width_;
+    conv(head.conv_, input, head_hidden_.data());
+    relu(head_hidden_.data(), head_hidden_size);
+    linear(head.fc_, head_hidden_.data(), logits);
+}
+
+float PCNCpuEngine::getExpectation(float* logits, int size) const
+{
+    // softmax over the value bins in place, then the expected bin index
+    softmax(logits, logits, size);
+    float expectation = 0.0f;
+    for (int i = 0; i < size; ++i) { expectation += i * logits[i]; }
+    return expectation;
+}
+
+} // namespace gamesolver
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <torch/script.h>
+#include <vector>
+
+namespace gamesolver {
+
+// Runs the proof cost network on CPU without libtorch dispatch, aimed at the tiny production models where
+// the per-op overhead of torch dominates the actual FLOPs. Batch norms are folded into the preceding
+// convolutions at load time, and all intermediate buffers are allocated once.
+// With reduced precision, the fully connected layers of the heads (where almost all weights are) are stored in
+// fp16, or in int8 with one scale per output feature and a dynamic per-call scale for the activations.
+class PCNCpuEngine {
+public:
+    enum class Precision {
+        kFP32,
+        kFP16,
+        kINT8
+    };
+
+    PCNCpuEngine(Precision precision = Precision::kFP32)
+        : precision_(precision),
+          has_board_evaluation_(false) {}
+
+    void load(torch::jit::script::Module& module, int num_input_channels, int channel_height, int channel_width);
+    // writes one row per sample, laid out as ProofCostNetworkOutput::bind() expects
+    void forward(const float* input, int batch_size, float* output);
+
+    inline int getActionSize() const { return policy_.fc_.out_features_; }
+    inline int getValueSize() const { return value_n_.fc_.out_features_; }
+    inline Precision getPrecision() const { return precision_; }
+    static bool useAVX2();
+    static Precision stringToPrecision(const std::string& precision);
+    static std::string precisionToString(Precision precision);
+
+private:
+    class ConvLayer {
+    public:
+        int in_channels_;
+        int out_channels_;
+        int kernel_size_;
+        std::vector<float> weight_; // [out_channels][in_channels * kernel_size * kernel_size]
+        std::vector<float> bias_;
+    };
+
+    class LinearLayer {
+    public:
+        int in_features_;
+        int out_features_;
+        std::vector<float> weight_; // [out_features][in_features]
+        std::vector<float> bias_;
+        std::vector<uint16_t> fp16_weight_;
+        std::vector<int8_t> int8_weight_;
+        std::vector<float> int8_weight_scale_; // per output feature
+    };
+
+    class Head {
+    public:
+        ConvLayer conv_;
+        LinearLayer fc_;
+    };
+
+    ConvLayer loadConv(const std::string& conv_name, const std::string& bn_name) const;
+    LinearLayer loadLinear(const std::string& name) const;
+    torch::Tensor getTensor(const std::string& name) const;
+    inline bool hasTensor(const std::string& name) const { return tensors_.count(name) > 0; }
+
+    void conv(const ConvLayer& layer, const float* input, float* output);
+    void quantize(LinearLayer& layer) const;
+    void linear(const LinearLayer& layer, const float* input, float* output);
+    void forwardHead(const Head& head, const float* input, float* logits);
+    float getExpectation(float* logits, int size) const;
+
+    Precision precision_;
+    int channel_height_;
+    int channel_width_;
+    int num_input_channels_;
+    bool has_board_evaluation_;
+    std::map<std::string, torch::Tensor> tensors_;
+
+    ConvLayer conv_;
+    std::vector<std::pair<ConvLayer, ConvLayer>> residual_blocks_;
+    Head policy_;
+    Head value_n_;
+    Head value_m_;
+    ConvLayer board_evaluation_;
+
+    std::vector<float> hidden_;
+    std::vector<float> block_hidden_;
+    std::vector<float> block_output_;
+    std::vector<float> columns_;
+    std::vector<float> head_hidden_;
+    std::vector<float> logits_;
+    std::vector<int8_t> int8_input_;
+};
+
+} // namespace gamesolver
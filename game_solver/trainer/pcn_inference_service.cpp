@@ -0,0 +1,127 @@
+#include "pcn_inference_service.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace gamesolver {
+
+using namespace minizero;
+using namespace minizero::network;
+
+PCNInferenceService::PCNInferenceService(const std::vector<std::shared_ptr<Network>>& networks, int num_clients, int max_batch_size, int timeout_us)
+    : stop_(false),
+      max_batch_size_(std::max(1, std::min(max_batch_size, ProofCostNetwork::getMaxBatchSize()))),
+      timeout_us_(std::max(0, timeout_us)),
+      num_completed_batches_(0)
+{
+    assert(!networks.empty());
+    for (int client_id = 0; client_id < num_clients; ++client_id) { clients_.emplace_back(std::make_unique<Client>()); }
+    for (auto& network : networks) {
+        batchers_.emplace_back(std::make_unique<Batcher>());
+        batchers_.back()->network_ = std::static_pointer_cast<ProofCostNetwork>(network);
+    }
+    for (auto& batcher : batchers_) { batcher->thread_ = std::thread(&PCNInferenceService::runBatcher, this, std::ref(*batcher)); }
+}
+
+PCNInferenceService::~PCNInferenceService()
+{
+    stop();
+}
+
+void PCNInferenceService::submit(int client_id, uint64_t tag, std::vector<float>&& features)
+{
+    assert(client_id >= 0 && client_id < static_cast<int>(clients_.size()));
+    Batcher& batcher = *batchers_[client_id % batchers_.size()];
+    {
+        std::lock_guard<std::mutex> lock(batcher.mutex_);
+        batcher.requests_.emplace_back(client_id, tag, std::move(features));
+    }
+    batcher.cv_.notify_one();
+}
+
+void PCNInferenceService::popCompletions(int client_id, std::vector<Completion>& completions)
+{
+    assert(client_id >= 0 && client_id < static_cast<int>(clients_.size()));
+    Client& client = *clients_[client_id];
+    std::lock_guard<std::mutex> lock(client.mutex_);
+
+    // the outputs of the previous pop have been consumed, their buffers take the next rows unless still referenced
+    for (auto& output : client.popped_outputs_) {
+        if (output.use_count() == 1) { client.free_outputs_.push_back(std::move(output)); }
+    }
+    client.popped_outputs_.clear();
+
+    completions.swap(client.completions_);
+    client.completions_.clear();
+    for (const auto& completion : completions) { client.popped_outputs_.push_back(completion.output_); }
+}
+
+bool PCNInferenceService::waitForCompletions(uint64_t& num_seen_batches, int timeout_us)
+{
+    std::unique_lock<std::mutex> lock(completion_mutex_);
+    bool has_new_batches = completion_cv_.wait_for(lock, std::chrono::microseconds(timeout_us), [&] { return num_completed_batches_ != num_seen_batches; });
+    num_seen_batches = num_completed_batches_;
+    return has_new_batches;
+}
+
+void PCNInferenceService::stop()
+{
+    for (auto& batcher : batchers_) {
+        {
+            std::lock_guard<std::mutex> lock(batcher->mutex_);
+            stop_ = true;
+        }
+        batcher->cv_.notify_all();
+    }
+    for (auto& batcher : batchers_) {
+        if (batcher->thread_.joinable()) { batcher->thread_.join(); }
+    }
+}
+
+void PCNInferenceService::runBatcher(Batcher& batcher)
+{
+    std::vector<Request> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(batcher.mutex_);
+            batcher.cv_.wait(lock, [&] { return stop_ || !batcher.requests_.empty(); });
+
+            // give the other solvers a chance to fill up the batch before flushing it
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us_);
+            batcher.cv_.wait_until(lock, deadline, [&] { return stop_ || static_cast<int>(batcher.requests_.size()) >= max_batch_size_; });
+            if (stop_) { return; }
+
+            int batch_size = std::min(static_cast<int>(batcher.requests_.size()), max_batch_size_);
+            batch.assign(std::make_move_iterator(batcher.requests_.begin()), std::make_move_iterator(batcher.requests_.begin() + batch_size));
+            batcher.requests_.erase(batcher.requests_.begin(), batcher.requests_.begin() + batch_size);
+        }
+
+        for (const auto& request : batch) { batcher.network_->pushBack(request.features_); }
+        std::vector<std::shared_ptr<NetworkOutput>> network_outputs = batcher.network_->forward();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            // outputs are views into the network's result buffer, which the next forward overwrites
+            Client& client = *clients_[batch[i].client_id_];
+            std::lock_guard<std::mutex> lock(client.mutex_);
+            std::shared_ptr<ProofCostNetworkOutput> pcn_output;
+            if (!client.free_outputs_.empty()) {
+                pcn_output = std::move(client.free_outputs_.back());
+                client.free_outputs_.pop_back();
+            } else {
+                pcn_output = std::make_shared<ProofCostNetworkOutput>();
+            }
+            pcn_output->copyFrom(*std::static_pointer_cast<ProofCostNetworkOutput>(network_outputs[i]));
+            client.completions_.emplace_back(batch[i].tag_, pcn_output);
+        }
+        batch.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(completion_mutex_);
+            ++num_completed_batches_;
+        }
+        completion_cv_.notify_all();
+    }
+}
+
+} // namespace gamesolver
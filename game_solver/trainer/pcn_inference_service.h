@@ -0,0 +1,82 @@
+#pragma once
+
+#include "network.h"
+#include "proof_cost_network.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gamesolver {
+
+// Decouples solvers from the network forward: solvers submit leaves at any time, one batcher thread per network
+// flushes them when the batch is full or the oldest leaf has waited long enough, and the outputs are handed back
+// through a completion list per client. Outputs are copied into buffers owned by the client, which are reused
+// once the client pops its completions again, so they are only valid until then.
+class PCNInferenceService {
+public:
+    class Completion {
+    public:
+        Completion(uint64_t tag, const std::shared_ptr<ProofCostNetworkOutput>& output)
+            : tag_(tag), output_(output) {}
+
+        uint64_t tag_;
+        std::shared_ptr<ProofCostNetworkOutput> output_;
+    };
+
+    PCNInferenceService(const std::vector<std::shared_ptr<minizero::network::Network>>& networks, int num_clients, int max_batch_size, int timeout_us);
+    ~PCNInferenceService();
+
+    void submit(int client_id, uint64_t tag, std::vector<float>&& features);
+    void popCompletions(int client_id, std::vector<Completion>& completions);
+    bool waitForCompletions(uint64_t& num_seen_batches, int timeout_us);
+    void stop();
+
+    inline int getMaxBatchSize() const { return max_batch_size_; }
+
+private:
+    class Request {
+    public:
+        Request(int client_id, uint64_t tag, std::vector<float>&& features)
+            : client_id_(client_id), tag_(tag), features_(std::move(features)) {}
+
+        int client_id_;
+        uint64_t tag_;
+        std::vector<float> features_;
+    };
+
+    class Batcher {
+    public:
+        std::shared_ptr<ProofCostNetwork> network_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<Request> requests_;
+        std::thread thread_;
+    };
+
+    class Client {
+    public:
+        std::mutex mutex_;
+        std::vector<Completion> completions_;
+        std::vector<std::shared_ptr<ProofCostNetworkOutput>> popped_outputs_;
+        std::vector<std::shared_ptr<ProofCostNetworkOutput>> free_outputs_;
+    };
+
+    void runBatcher(Batcher& batcher);
+
+    std::atomic<bool> stop_;
+    int max_batch_size_;
+    int timeout_us_;
+    std::vector<std::unique_ptr<Batcher>> batchers_;
+    std::vector<std::unique_ptr<Client>> clients_;
+
+    uint64_t num_completed_batches_;
+    std::mutex completion_mutex_;
+    std::condition_variable completion_cv_;
+};
+
+} // namespace gamesolver
@@ -1,48 +1,141 @@
 #pragma once
 
 #include "configuration.h"
+#include "gs_configuration.h"
 #include "network.h"
+#include "pcn_cpu_engine.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <torch/cuda.h>
 #include <vector>
 
 namespace gamesolver {
 
+template <class DataType>
+class ArrayView {
+public:
+    ArrayView() : data_(nullptr), size_(0) {}
+    ArrayView(const DataType* data, size_t size) : data_(data), size_(size) {}
+
+    inline const DataType& operator[](size_t index) const { return data_[index]; }
+    inline const DataType* data() const { return data_; }
+    inline const DataType* begin() const { return data_; }
+    inline const DataType* end() const { return data_ + size_; }
+    inline size_t size() const { return size_; }
+
+private:
+    const DataType* data_;
+    size_t size_;
+};
+
 class ProofCostNetworkOutput : public minizero::network::NetworkOutput {
 public:
     float value_n_;
     float value_m_;
-    std::vector<float> policy_;
-    std::vector<float> policy_logits_;
-    std::vector<float> board_evaluation_;
+    ArrayView<float> policy_;
+    ArrayView<float> policy_logits_;
+    ArrayView<float> board_evaluation_;
 
-    ProofCostNetworkOutput(int policy_size)
+    uint64_t model_version_; // version of the model that produced this output
+
+    ProofCostNetworkOutput()
     {
         value_n_ = value_m_ = 0.0f;
-        policy_.resize(policy_size, 0.0f);
-        policy_logits_.resize(policy_size, 0.0f);
-        board_evaluation_.resize(policy_size - 1, 0.0f);
+        model_version_ = 0;
+    }
+
+    // a result row is laid out as [policy | policy_logits | board_evaluation | value_n | value_m]
+    static inline int getRowSize(int policy_size) { return 3 * policy_size + 1; }
+
+    void bind(const float* row, int policy_size)
+    {
+        policy_ = ArrayView<float>(row, policy_size);
+        policy_logits_ = ArrayView<float>(row + policy_size, policy_size);
+        board_evaluation_ = ArrayView<float>(row + 2 * policy_size, policy_size - 1);
+        value_n_ = row[3 * policy_size - 1];
+        value_m_ = row[3 * policy_size];
+    }
+
+    // output owning its row, which is laid out as bind() expects
+    static std::shared_ptr<ProofCostNetworkOutput> create(std::vector<float>&& row, int policy_size)
+    {
+        assert(static_cast<int>(row.size()) == getRowSize(policy_size));
+        std::shared_ptr<ProofCostNetworkOutput> output = std::make_shared<ProofCostNetworkOutput>();
+        output->storage_ = std::move(row);
+        output->bind(output->storage_.data(), policy_size);
+        return output;
+    }
+
+    // deep copy that stays valid after the network has run its next batch
+    std::shared_ptr<ProofCostNetworkOutput> clone() const
+    {
+        std::shared_ptr<ProofCostNetworkOutput> output = std::make_shared<ProofCostNetworkOutput>();
+        output->copyFrom(*this);
+        return output;
+    }
+
+    // copies another output into the row owned by this one, reusing its storage
+    void copyFrom(const ProofCostNetworkOutput& other)
+    {
+        const int policy_size = other.policy_.size();
+        storage_.resize(getRowSize(policy_size));
+        std::copy(other.policy_.begin(), other.policy_.end(), storage_.begin());
+        std::copy(other.policy_logits_.begin(), other.policy_logits_.end(), storage_.begin() + policy_size);
+        std::copy(other.board_evaluation_.begin(), other.board_evaluation_.end(), storage_.begin() + 2 * policy_size);
+        storage_[3 * policy_size - 1] = other.value_n_;
+        storage_[3 * policy_size] = other.value_m_;
+        bind(storage_.data(), policy_size);
+        model_version_ = other.model_version_;
     }
+
+private:
+    std::vector<float> storage_;
 };
 
 class ProofCostNetwork : public minizero::network::Network {
 public:
-    ProofCostNetwork()
+    ProofCostNetwork(bool use_cpu_engine = gamesolver::nn_use_cpu_engine, PCNCpuEngine::Precision precision = PCNCpuEngine::stringToPrecision(gamesolver::nn_quantization))
+        : use_cpu_engine_(useCpuEngine(use_cpu_engine, precision)),
+          precision_(precision)
     {
         batch_size_ = 0;
-        clearTensorInput();
+        model_version_ = 0;
+        has_standby_network_ = false;
     }
 
-    void loadModel(const std::string& nn_file_name, const int gpu_id) override
+    ~ProofCostNetwork()
     {
-        Network::loadModel(nn_file_name, gpu_id);
-        std::vector<torch::jit::IValue> dummy;
-        value_size_ = network_.get_method("get_value_size")(dummy).toInt();
-        batch_size_ = 0;
-        minizero::config::nn_action_size = action_size_;
-        minizero::config::nn_discrete_value_size = value_size_;
+        if (load_thread_.joinable()) { load_thread_.join(); }
+    }
+
+    void loadModel(const std::string& nn_file_name, const int gpu_id) override { loadNetwork(nn_file_name, gpu_id); }
+
+    // loads the model into a standby network on a background thread, forward() switches to it between batches
+    void loadModelAsync(const std::string& nn_file_name)
+    {
+        if (load_thread_.joinable()) { load_thread_.join(); }
+        load_thread_ = std::thread([this, nn_file_name]() {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::shared_ptr<ProofCostNetwork> standby_network = std::make_shared<ProofCostNetwork>(use_cpu_engine_, precision_);
+            standby_network->loadNetwork(nn_file_name, getGPUID()); // the model version changes only when forward() switches to it
+
+            std::lock_guard<std::mutex> lock(standby_mutex_);
+            standby_network_ = standby_network;
+            standby_nn_file_name_ = nn_file_name;
+            standby_load_start_ = start;
+            standby_load_end_ = std::chrono::steady_clock::now();
+            has_standby_network_ = true;
+        });
     }
 
     std::string toString() const override
@@ -52,86 +145,167 @@ public:
         return oss.str();
     }
 
-    int pushBack(std::vector<float> features)
+    int pushBack(const std::vector<float>& features)
     {
-        assert(static_cast<int>(features.size()) == getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth());
+        assert(static_cast<int>(features.size()) == getInputSize());
 
-        int index;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            index = batch_size_++;
-            tensor_input_.resize(batch_size_);
+        // each caller owns its slot of the preallocated batch, so no lock is needed for writing features
+        int index = batch_size_++;
+        if (index >= kMaxBatchSize) {
+            --batch_size_;
+            throw std::length_error("ProofCostNetwork::pushBack: batch exceeds " + std::to_string(kMaxBatchSize) + " positions");
         }
-        tensor_input_[index] = torch::from_blob(features.data(), {1, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}).clone();
+        std::copy(features.begin(), features.end(), tensor_input_.data_ptr<float>() + static_cast<int64_t>(index) * getInputSize());
         return index;
     }
 
     std::vector<std::shared_ptr<minizero::network::NetworkOutput>> forward()
     {
         assert(batch_size_ > 0);
-        auto forward_result = network_.forward(std::vector<torch::jit::IValue>{torch::cat(tensor_input_).to(getDevice())}).toGenericDict();
-
-        auto policy_output = forward_result.at("policy").toTensor().to(at::kCPU);
-        auto policy_logits_output = forward_result.at("policy_logit").toTensor().to(at::kCPU);
-        auto value_n_output = forward_result.at("value_n").toTensor().to(at::kCPU);
-        auto value_m_output = forward_result.at("value_m").toTensor().to(at::kCPU);
-        auto board_evaluate_output = (forward_result.contains("board_evaluation")) ? forward_result.at("board_evaluation").toTensor().to(at::kCPU) : torch::zeros(batch_size_ * (getActionSize() - 1));
-        assert(policy_output.numel() == batch_size_ * getActionSize());
-        assert(policy_logits_output.numel() == batch_size_ * getActionSize());
-        assert(value_n_output.numel() == batch_size_ * getValueSize());
-        assert(value_m_output.numel() == batch_size_ * getValueSize());
-        assert(board_evaluate_output.numel() == batch_size_ * (getActionSize() - 1));
-
-        const int policy_size = getActionSize();
-        const int board_evaluation_size = getActionSize() - 1;
+        if (has_standby_network_) { swapStandbyNetwork(); }
+        const int batch_size = batch_size_;
+        if (cpu_engine_) {
+            cpu_engine_->forward(tensor_input_.data_ptr<float>(), batch_size, output_batch_->buffer_.data_ptr<float>());
+        } else {
+            forwardTorch(batch_size);
+        }
+
         std::vector<std::shared_ptr<minizero::network::NetworkOutput>> network_outputs;
-        for (int i = 0; i < batch_size_; ++i) {
-            network_outputs.emplace_back(std::make_shared<ProofCostNetworkOutput>(policy_size));
-            auto proof_cost_network_output = std::static_pointer_cast<ProofCostNetworkOutput>(network_outputs.back());
-            std::copy(policy_output.data_ptr<float>() + i * policy_size,
-                      policy_output.data_ptr<float>() + (i + 1) * policy_size,
-                      proof_cost_network_output->policy_.begin());
-            std::copy(policy_logits_output.data_ptr<float>() + i * policy_size,
-                      policy_logits_output.data_ptr<float>() + (i + 1) * policy_size,
-                      proof_cost_network_output->policy_logits_.begin());
-            std::copy(board_evaluate_output.data_ptr<float>() + i * board_evaluation_size,
-                      board_evaluate_output.data_ptr<float>() + (i + 1) * board_evaluation_size,
-                      proof_cost_network_output->board_evaluation_.begin());
-
-            // change value distribution to scalar
-            int value_start = 0;
-            proof_cost_network_output->value_n_ = std::accumulate(value_n_output.data_ptr<float>() + i * getValueSize(),
-                                                                  value_n_output.data_ptr<float>() + (i + 1) * getValueSize(),
-                                                                  0.0f,
-                                                                  [&value_start](const float& sum, const float& value) { return sum + value * value_start++; });
-            value_start = 0;
-            proof_cost_network_output->value_m_ = std::accumulate(value_m_output.data_ptr<float>() + i * getValueSize(),
-                                                                  value_m_output.data_ptr<float>() + (i + 1) * getValueSize(),
-                                                                  0.0f,
-                                                                  [&value_start](const float& sum, const float& value) { return sum + value * value_start++; });
+        network_outputs.reserve(batch_size);
+        const float* output_data = output_batch_->buffer_.data_ptr<float>();
+        const int row_size = ProofCostNetworkOutput::getRowSize(getActionSize());
+        for (int i = 0; i < batch_size; ++i) {
+            ProofCostNetworkOutput& proof_cost_network_output = output_batch_->outputs_[i];
+            proof_cost_network_output.bind(output_data + static_cast<int64_t>(i) * row_size, getActionSize());
+            proof_cost_network_output.model_version_ = model_version_;
+            network_outputs.emplace_back(output_batch_, &proof_cost_network_output); // share ownership of the buffer and the pool, no per-sample allocation
         }
 
         batch_size_ = 0;
-        clearTensorInput();
         return network_outputs;
     }
 
+    inline bool isUsingCpuEngine() const { return cpu_engine_ != nullptr; }
+    inline PCNCpuEngine::Precision getPrecision() const { return precision_; }
     inline int getValueSize() const { return value_size_; }
     inline int getBatchSize() const { return batch_size_; }
+    inline int getInputSize() const { return getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth(); }
+    static inline int getMaxBatchSize() { return kMaxBatchSize; }
+    // quantized modes only exist in the native CPU engine
+    static inline bool useCpuEngine(bool use_cpu_engine = gamesolver::nn_use_cpu_engine, PCNCpuEngine::Precision precision = PCNCpuEngine::stringToPrecision(gamesolver::nn_quantization)) { return use_cpu_engine || precision != PCNCpuEngine::Precision::kFP32; }
+    inline uint64_t getModelVersion() const { return model_version_; }
 
 private:
-    inline void clearTensorInput()
+    // the result buffer together with the outputs viewing it, each output returned by forward() keeps the whole batch alive
+    class OutputBatch {
+    public:
+        torch::Tensor buffer_;
+        std::vector<ProofCostNetworkOutput> outputs_;
+    };
+
+    void loadNetwork(const std::string& nn_file_name, const int gpu_id)
+    {
+        Network::loadModel(nn_file_name, gpu_id);
+        model_version_ = getModelFileVersion(nn_file_name);
+        std::vector<torch::jit::IValue> dummy;
+        value_size_ = network_.get_method("get_value_size")(dummy).toInt();
+        cpu_engine_ = nullptr;
+        if (use_cpu_engine_) {
+            cpu_engine_ = std::make_shared<PCNCpuEngine>(precision_);
+            cpu_engine_->load(network_, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth());
+            assert(cpu_engine_->getActionSize() == action_size_ && cpu_engine_->getValueSize() == value_size_);
+        }
+        batch_size_ = 0;
+        allocateTensorInput();
+        allocateOutputBuffer();
+        minizero::config::nn_action_size = action_size_;
+        minizero::config::nn_discrete_value_size = value_size_;
+    }
+
+    // each model is tagged by its content, so networks running the same model share cached outputs
+    // while a retrained model written to the same file gets a new version
+    static inline uint64_t getModelFileVersion(const std::string& nn_file_name)
+    {
+        std::ifstream fin(nn_file_name, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+        return std::hash<std::string>()(content);
+    }
+
+    inline void swapStandbyNetwork()
+    {
+        std::lock_guard<std::mutex> lock(standby_mutex_);
+        if (standby_network_->getActionSize() != getActionSize() || standby_network_->getValueSize() != getValueSize() || standby_network_->getInputSize() != getInputSize()) {
+            std::cerr << "[ProofCostNetwork] ignore " << standby_nn_file_name_ << ": its input/output sizes differ from the running model" << std::endl;
+        } else {
+            network_ = standby_network_->network_;
+            cpu_engine_ = standby_network_->cpu_engine_;
+            model_version_ = standby_network_->model_version_.load(); // published with the network, outputs of earlier batches keep the old version
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            std::cerr << "[ProofCostNetwork] switched to " << standby_nn_file_name_
+                      << ", load time: " << std::chrono::duration_cast<std::chrono::milliseconds>(standby_load_end_ - standby_load_start_).count() << " ms"
+                      << ", request to switch: " << std::chrono::duration_cast<std::chrono::milliseconds>(now - standby_load_start_).count() << " ms" << std::endl;
+        }
+        standby_network_ = nullptr;
+        has_standby_network_ = false;
+    }
+
+    inline void forwardTorch(int batch_size)
+    {
+        auto forward_result = network_.forward(std::vector<torch::jit::IValue>{tensor_input_.narrow(0, 0, batch_size).to(getDevice(), torch::kFloat32, /* non_blocking */ true)}).toGenericDict();
+
+        torch::Tensor policy_output = forward_result.at("policy").toTensor().view({batch_size, getActionSize()});
+        torch::Tensor policy_logits_output = forward_result.at("policy_logit").toTensor().view({batch_size, getActionSize()});
+        torch::Tensor board_evaluate_output = (forward_result.contains("board_evaluation")) ? forward_result.at("board_evaluation").toTensor().view({batch_size, getActionSize() - 1}) : torch::zeros({batch_size, getActionSize() - 1}, policy_output.options());
+
+        // change both value distributions to scalars by one matmul with the bin indices
+        torch::Tensor value_distribution = torch::stack({forward_result.at("value_n").toTensor(), forward_result.at("value_m").toTensor()}, 1);
+        assert(value_distribution.numel() == batch_size * 2 * getValueSize());
+        torch::Tensor value_output = torch::matmul(value_distribution, value_bins_);
+
+        // gather all heads on the device and copy them to the reused host buffer at once
+        torch::Tensor output = torch::cat({policy_output, policy_logits_output, board_evaluate_output, value_output}, 1);
+        assert(output.size(1) == ProofCostNetworkOutput::getRowSize(getActionSize()));
+        output_batch_->buffer_.narrow(0, 0, batch_size).copy_(output);
+    }
+
+    inline void allocateTensorInput()
     {
-        tensor_input_.clear();
-        tensor_input_.reserve(kReserved_batch_size);
+        // one contiguous (pinned when feeding a GPU) buffer holding the whole batch, filled in place by pushBack()
+        auto options = torch::TensorOptions().dtype(torch::kFloat32).pinned_memory(torch::cuda::is_available());
+        tensor_input_ = torch::zeros({kMaxBatchSize, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}, options);
+    }
+
+    inline void allocateOutputBuffer()
+    {
+        // outputs returned by forward() are views into this buffer and stay valid until the next forward(),
+        // a reload allocates a new batch and leaves the old one to the outputs still holding it
+        auto options = torch::TensorOptions().dtype(torch::kFloat32).pinned_memory(torch::cuda::is_available());
+        output_batch_ = std::make_shared<OutputBatch>();
+        output_batch_->buffer_ = torch::zeros({kMaxBatchSize, ProofCostNetworkOutput::getRowSize(getActionSize())}, options);
+        output_batch_->outputs_.resize(kMaxBatchSize);
+        value_bins_ = torch::arange(getValueSize(), torch::TensorOptions().dtype(torch::kFloat32)).to(getDevice());
     }
 
     int value_size_;
-    int batch_size_;
-    std::mutex mutex_;
-    std::vector<torch::Tensor> tensor_input_;
+    bool use_cpu_engine_;
+    PCNCpuEngine::Precision precision_;
+    std::shared_ptr<PCNCpuEngine> cpu_engine_;
+    std::atomic<int> batch_size_;
+    std::atomic<uint64_t> model_version_;
+    torch::Tensor tensor_input_;
+    torch::Tensor value_bins_;
+    std::shared_ptr<OutputBatch> output_batch_;
+
+    std::thread load_thread_;
+    std::mutex standby_mutex_;
+    std::atomic<bool> has_standby_network_;
+    std::shared_ptr<ProofCostNetwork> standby_network_;
+    std::string standby_nn_file_name_;
+    std::chrono::steady_clock::time_point standby_load_start_;
+    std::chrono::steady_clock::time_point standby_load_end_;
 
-    const int kReserved_batch_size = 4096;
+    static constexpr int kMaxBatchSize = 4096;
 };
 
 } // namespace gamesolver
@@ -1,5 +1,8 @@
 #include "base_solver.h"
+#include "solved_position_db.h"
 #include "tree_logger.h"
+#include "tree_summary.h"
+#include <algorithm>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -28,13 +31,21 @@ void BaseSolver::resetSearch()
 {
     GSActor::resetSearch();
     rzone_tt_handler_.clear();
+    ++inference_generation_;
+    inference_sequence_ = 0;
+    inflight_leaves_.clear();
+    cached_nn_output_ = nullptr;
+    is_time_limit_reached_ = false;
+    is_search_done_handled_ = false;
 }
 
 void BaseSolver::setSolverJob(const SolverJob& solver_job)
 {
+    resizeTree(solver_job.max_nodes_);
     reset();
     is_idle_ = false;
     solver_job_ = solver_job;
+    job_start_time_ = std::chrono::steady_clock::now();
     utils::SGFLoader sgf_loader;
     sgf_loader.loadFromString(solver_job_.sgf_);
     for (auto& action_pair : sgf_loader.getActions()) {
@@ -42,32 +53,148 @@ void BaseSolver::setSolverJob(const SolverJob& solver_job)
     }
 }
 
+bool BaseSolver::reachSearchBudget() const
+{
+    if (solver_job_.max_nodes_ > 0 ? getMCTS()->getRootNode()->getCount() >= solver_job_.max_nodes_ : getMCTS()->reachMaximumSimulation()) { return true; }
+    // latched so that the search cannot come back from done once the clock has been checked
+    if (!is_time_limit_reached_ && solver_job_.time_limit_ > 0) { is_time_limit_reached_ = (std::chrono::duration<float>(std::chrono::steady_clock::now() - job_start_time_).count() >= solver_job_.time_limit_); }
+    return is_time_limit_reached_;
+}
+
+bool BaseSolver::reachSplitBudget() const
+{
+    if (getMCTS()->getRootNode()->isLeaf()) { return false; }
+    if (gamesolver::solver_split_nodes > 0 && getMCTS()->getRootNode()->getCount() >= gamesolver::solver_split_nodes) { return true; }
+    return (gamesolver::solver_split_time > 0 && std::chrono::duration<float>(std::chrono::steady_clock::now() - job_start_time_).count() >= gamesolver::solver_split_time);
+}
+
+void BaseSolver::splitJob()
+{
+    // the tree is abandoned, the manager continues from the returned frontier
+    solver_job_.is_split_ = true;
+    handleSearchDone();
+}
+
+void BaseSolver::resizeTree(int max_nodes)
+{
+    // the tree follows the job's simulation budget: larger jobs grow it, and it shrinks (down to a floor) only when a job
+    // needs less than half of it, so that jobs with similar budgets do not reallocate the tree every time
+    uint64_t tree_node_size = default_tree_node_size_;
+    if (max_nodes > 0) {
+        uint64_t min_tree_node_size = std::min(default_tree_node_size_, static_cast<uint64_t>(kMinTreeSimulations + 1) * pcn_network_->getActionSize());
+        tree_node_size = std::max(min_tree_node_size, static_cast<uint64_t>(max_nodes + 1) * pcn_network_->getActionSize());
+    }
+    if (tree_node_size <= tree_node_size_ && tree_node_size * 2 > tree_node_size_) { return; }
+    tree_node_size_ = tree_node_size;
+    search_ = createSearch();
+}
+
+uint64_t BaseSolver::getMemoryUsage() const
+{
+    // search data that grows with the job; the fixed-size TT tables are not counted
+    const std::shared_ptr<GSMCTS> mcts = getMCTS();
+    uint64_t memory_usage = mcts->getNumUsedNodes() * sizeof(GSMCTSNode);
+    memory_usage += mcts->getTreeRZoneData().size() * sizeof(ZonePattern);
+    for (int i = 0; i < mcts->getTreeGHIData().size(); ++i) { memory_usage += sizeof(GHIData) + mcts->getTreeGHIData().getData(i).getPatterns().size() * sizeof(ZonePattern); }
+    memory_usage += mcts->getGHINodeMap().size() * (sizeof(GSMCTSNode*) + sizeof(int));
+    memory_usage += (rzone_tt_handler_.getGridTT().getTTSize() + rzone_tt_handler_.getBlockTT().getTTSize()) * sizeof(RZoneTTPattern);
+    return memory_usage;
+}
+
 Action BaseSolver::think(bool with_play /*= false*/, bool display_board /*= false*/)
 {
     is_idle_ = false;
     resetSearch();
     while (!isSearchDone()) {
         beforeNNEvaluation();
-        if (pcn_network_->getBatchSize() == 0) { continue; }
-        afterNNEvaluation(pcn_network_->forward()[getNNEvaluationBatchIndex()]);
+        if (cached_nn_output_) {
+            afterNNEvaluation(cached_nn_output_);
+        } else if (pcn_network_->getBatchSize() > 0) {
+            afterNNEvaluation(pcn_network_->forward()[getNNEvaluationBatchIndex()]);
+        }
     }
+    finishSearch();
     return Action();
 }
 
+void BaseSolver::stepAsync()
+{
+    assert(inference_service_ && inference_client_id_ >= 0);
+
+    // consume the evaluated leaves, results submitted before the last tree reset are dropped
+    inference_service_->popCompletions(inference_client_id_, inference_completions_);
+    for (const auto& completion : inference_completions_) {
+        if (static_cast<uint32_t>(completion.tag_ >> 32) != inference_generation_) { continue; }
+        auto it = std::find_if(inflight_leaves_.begin(), inflight_leaves_.end(), [&](const InflightLeaf& leaf) { return leaf.tag_ == completion.tag_; });
+        if (it == inflight_leaves_.end()) { continue; }
+
+        mcts_search_data_.node_path_.swap(it->node_path_);
+        pcn_cache_key_ = it->pcn_cache_key_;
+        pcn_cache_position_map_.swap(it->pcn_cache_position_map_);
+        cached_nn_output_ = nullptr;
+        inflight_leaves_.erase(it);
+        handleEvaluatedLeaf(completion.output_);
+    }
+    inference_completions_.clear();
+
+    // keep several leaves waiting for evaluation, virtual loss spreads the selections over the tree
+    while (!isSearchDone() && static_cast<int>(inflight_leaves_.size()) < getMaxInflightLeaves()) {
+        std::vector<MCTSNode*> node_path = selection();
+        if (isSearchDone()) {
+            handleSearchDone();
+            break;
+        }
+        if (isLeafInflight(node_path.back())) { break; }
+
+        for (auto& node : node_path) { node->addVirtualLoss(); }
+        Environment env_transition = getEnvironmentTransition(node_path);
+        if (gamesolver::use_pcn_cache && (cached_nn_output_ = lookupPCNCache(env_transition))) {
+            mcts_search_data_.node_path_ = node_path;
+            handleEvaluatedLeaf(cached_nn_output_);
+            continue;
+        }
+
+        uint64_t tag = (static_cast<uint64_t>(inference_generation_) << 32) | inference_sequence_++;
+        inference_service_->submit(inference_client_id_, tag, env_transition.getFeatures());
+        inflight_leaves_.emplace_back(tag, node_path, pcn_cache_key_, pcn_cache_position_map_);
+    }
+}
+
+void BaseSolver::handleEvaluatedLeaf(const std::shared_ptr<NetworkOutput>& network_output)
+{
+    // the leaf was selected under virtual loss, see stepAsync
+    for (auto& node : mcts_search_data_.node_path_) { node->removeVirtualLoss(); }
+    if (!isSearchDone()) { afterNNEvaluation(network_output); }
+}
+
 void BaseSolver::beforeNNEvaluation()
+{
+    if (selectLeaf()) { pushLeaf(); }
+}
+
+bool BaseSolver::selectLeaf()
 {
     mcts_search_data_.node_path_ = selection();
+    cached_nn_output_ = nullptr;
+    nn_evaluation_batch_id_ = -1;
     if (isSearchDone()) {
         handleSearchDone();
-        nn_evaluation_batch_id_ = -1;
-        return;
+        return false;
     }
+    return true;
+}
+
+void BaseSolver::pushLeaf()
+{
+    // the selected leaf takes a batch slot unless its output is in the PCN cache
     Environment env_transition = getEnvironmentTransition(mcts_search_data_.node_path_);
+    if (gamesolver::use_pcn_cache && (cached_nn_output_ = lookupPCNCache(env_transition))) { return; }
     nn_evaluation_batch_id_ = pcn_network_->pushBack(env_transition.getFeatures());
 }
 
 void BaseSolver::afterNNEvaluation(const std::shared_ptr<NetworkOutput>& network_output)
 {
+    if (gamesolver::use_pcn_cache && network_output != cached_nn_output_) { PCNCache::instance().store(pcn_cache_key_, pcn_cache_position_map_, *std::static_pointer_cast<ProofCostNetworkOutput>(network_output)); }
     GSActor::afterNNEvaluation(network_output);
 
     Environment env_transition = getEnvironmentTransition(mcts_search_data_.node_path_);
@@ -84,10 +211,21 @@ void BaseSolver::afterNNEvaluation(const std::shared_ptr<NetworkOutput>& network
 void BaseSolver::handleSearchDone()
 {
     assert(isSearchDone());
+    if (is_search_done_handled_) { return; }
+    is_search_done_handled_ = true;
     solver_job_.solver_status_ = getMCTS()->getRootNode()->getSolverStatus();
     if (getMCTS()->getRootNode()->getRZoneDataIndex() != -1) { solver_job_.rzone_bitboard_ = getMCTS()->getTreeRZoneData().getData(getMCTS()->getRootNode()->getRZoneDataIndex()).getRZone(); }
     solver_job_.nodes_ = getMCTS()->getRootNode()->getCount();
     if (gamesolver::use_ghi_check) { collectGHIInfo(getMCTS()->getRootNode(), solver_job_.ghi_data_); }
+    if (solver_job_.solver_status_ != SolverStatus::kSolverUnknown && solver_job_.ghi_data_.empty() && !getMCTS()->getRootNode()->isGHI()) {
+        SolvedPositionDB::instance().store(knowledge_handler_->getPositionHashKey(env_), solver_job_.solver_status_, solver_job_.rzone_bitboard_);
+    }
+    if (!getMCTS()->getRootNode()->isSolved()) {
+        int summary_depth = (solver_job_.is_split_ ? std::max(1, gamesolver::solver_tree_summary_depth) : gamesolver::solver_tree_summary_depth);
+        if (summary_depth > 0) { solver_job_.tree_summary_ = TreeSummary::summarize(*getMCTS(), summary_depth); }
+    } else {
+        solver_job_.is_split_ = false;
+    }
     if (gamesolver::log_solver_sgf) { TreeLogger::saveTreeStringToFile(gamesolver::solver_output_directory + "/tree_" + std::to_string(solver_job_.job_id_) + ".sgf", env_, getMCTS()); }
 }
 
@@ -266,6 +404,20 @@ void BaseSolver::collectGHIInfo(GSMCTSNode* node, GHIData& ghi_data)
     }
 }
 
+bool BaseSolver::isLeafInflight(const MCTSNode* leaf) const
+{
+    for (const auto& inflight_leaf : inflight_leaves_) {
+        if (inflight_leaf.node_path_.back() == leaf) { return true; }
+    }
+    return false;
+}
+
+std::shared_ptr<NetworkOutput> BaseSolver::lookupPCNCache(const Environment& env)
+{
+    pcn_cache_key_ = PCNCache::getCanonicalHashKey(knowledge_handler_->getStoneBitboard(env), env.getTurn(), knowledge_handler_->getKoPosition(env), env.getBoardSize(), knowledge_handler_->getSymmetries(), pcn_cache_position_map_);
+    return PCNCache::instance().lookup(pcn_cache_key_, pcn_cache_position_map_, pcn_network_->getModelVersion());
+}
+
 bool BaseSolver::hasRZonePatternInPositions(const ZonePattern& pattern, const std::vector<env::GamePair<GSBitboard>>& ancestor_positions) const
 {
     for (size_t position_index = 0; position_index < ancestor_positions.size(); ++position_index) {
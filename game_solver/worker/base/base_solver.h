@@ -1,10 +1,15 @@
 #pragma once
 
 #include "gs_actor.h"
+#include "gs_configuration.h"
 #include "knowledge_handler.h"
+#include "pcn_cache.h"
+#include "pcn_inference_service.h"
 #include "rzone_handler.h"
 #include "rzone_tt_handler.h"
 #include "solver_job.h"
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -14,8 +19,15 @@ class BaseSolver : public GSActor {
 public:
     BaseSolver(uint64_t tree_node_size)
         : GSActor(tree_node_size),
+          default_tree_node_size_(tree_node_size),
           rzone_handler_(nullptr),
-          knowledge_handler_(nullptr)
+          knowledge_handler_(nullptr),
+          inference_service_(nullptr),
+          inference_client_id_(-1),
+          inference_generation_(0),
+          inference_sequence_(0),
+          is_time_limit_reached_(false),
+          is_search_done_handled_(false)
     {
     }
 
@@ -26,16 +38,38 @@ public:
     Action think(bool with_play = false, bool display_board = false) override;
     void beforeNNEvaluation() override;
     void afterNNEvaluation(const std::shared_ptr<minizero::network::NetworkOutput>& network_output) override;
-    bool isSearchDone() const override { return (getMCTS()->reachMaximumSimulation() || getMCTS()->getRootNode()->isSolved()); }
+    bool isSearchDone() const override { return (getMCTS()->getRootNode()->isSolved() || solver_job_.is_split_ || reachSearchBudget()); }
+    bool reachSplitBudget() const;
+    void splitJob();
+    // the time limit can end the search between two steps, the result is filled in before the job is reported
+    inline void finishSearch()
+    {
+        if (isSearchDone()) { handleSearchDone(); }
+    }
+    void stepAsync();
+    inline const std::shared_ptr<minizero::network::NetworkOutput>& getCachedNNOutput() const { return cached_nn_output_; }
+
+    inline void setInferenceService(const std::shared_ptr<PCNInferenceService>& inference_service, int client_id)
+    {
+        inference_service_ = inference_service;
+        inference_client_id_ = client_id;
+    }
 
     inline void setIsIdle(bool is_idle) { is_idle_ = is_idle; }
     inline bool isIdle() const { return is_idle_; }
     inline const SolverJob& getSolverJob() const { return solver_job_; }
 
+    uint64_t getMemoryUsage() const;
+    inline uint64_t getMaxMemoryUsage() const { return tree_node_size_ * sizeof(GSMCTSNode); }
+
 protected:
     void handleSearchDone() override;
     std::vector<minizero::actor::MCTSNode*> selection() override;
-    void updateSolverStatus(SolverStatus status, std::vector<minizero::actor::MCTSNode*> node_path, const GSBitboard& rzone_bitboard);
+    bool selectLeaf();
+    void pushLeaf();
+    bool reachSearchBudget() const;
+    void resizeTree(int max_nodes);
+    virtual void updateSolverStatus(SolverStatus status, std::vector<minizero::actor::MCTSNode*> node_path, const GSBitboard& rzone_bitboard);
     void updateWinnerRZone(const Environment& env, GSMCTSNode* parent, const GSMCTSNode* child);
     void pruneNodesOutsideRZone(const Environment& env, const GSMCTSNode* parent, GSMCTSNode* node);
     bool isAllChildrenSolutionLoss(const GSMCTSNode* node) const;
@@ -50,11 +84,46 @@ protected:
     virtual std::shared_ptr<RZoneHandler> createRZoneHandler() = 0;
     virtual std::shared_ptr<KnowledgeHandler> createKnowledgeHandler() = 0;
 
+    class InflightLeaf {
+    public:
+        InflightLeaf(uint64_t tag, const std::vector<minizero::actor::MCTSNode*>& node_path, GSHashKey pcn_cache_key, const std::vector<int>& pcn_cache_position_map)
+            : tag_(tag), node_path_(node_path), pcn_cache_key_(pcn_cache_key), pcn_cache_position_map_(pcn_cache_position_map) {}
+
+        uint64_t tag_;
+        std::vector<minizero::actor::MCTSNode*> node_path_;
+        GSHashKey pcn_cache_key_;
+        std::vector<int> pcn_cache_position_map_;
+    };
+
+    virtual int getMaxInflightLeaves() const { return gamesolver::actor_num_inflight_leaves; }
+    virtual void handleEvaluatedLeaf(const std::shared_ptr<minizero::network::NetworkOutput>& network_output);
+    bool isLeafInflight(const minizero::actor::MCTSNode* leaf) const;
+    std::shared_ptr<minizero::network::NetworkOutput> lookupPCNCache(const Environment& env);
+
     bool is_idle_;
     SolverJob solver_job_;
+    std::chrono::steady_clock::time_point job_start_time_;
+    const uint64_t default_tree_node_size_;
     RZoneTTHandler rzone_tt_handler_;
     std::shared_ptr<RZoneHandler> rzone_handler_;
     std::shared_ptr<KnowledgeHandler> knowledge_handler_;
+
+    // network output cache: the key and orientation of the current leaf, and its output when it was a cache hit
+    GSHashKey pcn_cache_key_;
+    std::vector<int> pcn_cache_position_map_;
+    std::shared_ptr<minizero::network::NetworkOutput> cached_nn_output_;
+
+    // asynchronous inference: tags are (generation << 32 | sequence), the generation changes whenever the tree is reset
+    std::shared_ptr<PCNInferenceService> inference_service_;
+    int inference_client_id_;
+    uint32_t inference_generation_;
+    uint32_t inference_sequence_;
+    std::vector<InflightLeaf> inflight_leaves_;
+    std::vector<PCNInferenceService::Completion> inference_completions_;
+
+    mutable bool is_time_limit_reached_;
+    bool is_search_done_handled_;
+    const int kMinTreeSimulations = 1000;
 };
 
 } // namespace gamesolver
@@ -3,6 +3,7 @@
 #include "gs_bitboard.h"
 #include "gs_hashkey.h"
 #include "gs_mcts.h"
+#include "rotation.h"
 #include <memory>
 #include <vector>
 
@@ -16,8 +17,12 @@ public:
     virtual minizero::env::Player getWinner(const Environment& env) = 0;
     virtual std::vector<GSHashKey> getHashKeySequence(const Environment& env) = 0; // TODO: rename this
     virtual std::vector<GSHashKey> getHashKeySequenceInBitboard(const Environment& env, GSBitboard bitboard) = 0;
+    virtual GSHashKey getPositionHashKey(const Environment& env) = 0; // stones, turn and whatever else restricts the legal moves (e.g., ko)
+    virtual int getKoPosition(const Environment& env) = 0; // the position the player to move may not retake at once, -1 if none
     virtual void findGHI(const Environment& env, std::vector<minizero::actor::MCTSNode*>& node_path, std::shared_ptr<GSMCTS> mcts) = 0;
     virtual std::vector<minizero::env::GamePair<GSBitboard>> getAncestorPositions(const Environment& env, const std::vector<minizero::actor::MCTSNode*>& node_path) = 0;
+    virtual minizero::env::GamePair<GSBitboard> getStoneBitboard(const Environment& env) const = 0;
+    virtual std::vector<minizero::utils::Rotation> getSymmetries() const = 0; // board symmetries under which the game is unchanged
 };
 
 } // namespace gamesolver
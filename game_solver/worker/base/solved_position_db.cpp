@@ -0,0 +1,147 @@
+#include "solved_position_db.h"
+#include "gs_configuration.h"
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gamesolver {
+
+static const char kSolvedPositionDBMagic[8] = {'G', 'S', 'S', 'O', 'L', 'V', 'E', 'D'};
+
+SolvedPositionDB& SolvedPositionDB::instance()
+{
+    static SolvedPositionDB db;
+    return db;
+}
+
+SolvedPositionDB::SolvedPositionDB()
+    : fd_(-1),
+      file_size_(0),
+      mapped_(nullptr),
+      entries_(nullptr),
+      num_entries_(0),
+      num_hits_(0),
+      num_stores_(0)
+{
+    if (gamesolver::solved_position_db_file.empty()) { return; }
+    if (!open(gamesolver::solved_position_db_file, 1ULL << gamesolver::solved_position_db_bits)) {
+        std::cerr << "failed to open solved position database " << gamesolver::solved_position_db_file << std::endl;
+        close();
+    }
+}
+
+SolvedPositionDB::~SolvedPositionDB()
+{
+    close();
+}
+
+bool SolvedPositionDB::lookup(GSHashKey key, SolverStatus& solver_status, GSBitboard& rzone_bitboard)
+{
+    if (!isOpen()) { return false; }
+    if (key == 0) { key = 1; }
+    for (int probe = 0; probe < kMaxProbes; ++probe) {
+        Entry& entry = entries_[(key + probe) & (num_entries_ - 1)];
+        uint64_t entry_key = __atomic_load_n(&entry.key_, __ATOMIC_ACQUIRE);
+        if (entry_key == 0) { return false; }
+        if (entry_key != key) { continue; }
+        if (!__atomic_load_n(&entry.is_ready_, __ATOMIC_ACQUIRE)) { return false; }
+        solver_status = static_cast<SolverStatus>(entry.solver_status_);
+        rzone_bitboard = entry.rzone_;
+        ++num_hits_;
+        return true;
+    }
+    return false;
+}
+
+bool SolvedPositionDB::store(GSHashKey key, SolverStatus solver_status, const GSBitboard& rzone_bitboard)
+{
+    if (!isOpen() || solver_status == SolverStatus::kSolverUnknown) { return false; }
+    if (key == 0) { key = 1; }
+    for (int probe = 0; probe < kMaxProbes; ++probe) {
+        Entry& entry = entries_[(key + probe) & (num_entries_ - 1)];
+        uint64_t entry_key = 0;
+        if (!__atomic_compare_exchange_n(&entry.key_, &entry_key, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            if (entry_key == key) { return false; } // already stored, possibly by another process
+            continue;
+        }
+        entry.rzone_ = rzone_bitboard.to_ullong(); // TODO: avoid using more than 64-bit bitboard
+        entry.solver_status_ = static_cast<int8_t>(solver_status);
+        __atomic_store_n(&entry.is_ready_, 1, __ATOMIC_RELEASE);
+        ++num_stores_;
+        return true;
+    }
+    return false; // the probed entries are full, the result is dropped
+}
+
+std::string SolvedPositionDB::toString() const
+{
+    std::ostringstream oss;
+    oss << "solved position db: " << gamesolver::solved_position_db_file << ", hits: " << num_hits_ << ", stores: " << num_stores_;
+    return oss.str();
+}
+
+bool SolvedPositionDB::open(const std::string& file_name, uint64_t num_entries)
+{
+    fd_ = ::open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) { return false; }
+
+    // processes opening the file at once are serialized until it is created or validated, the lock goes with fd_ on failure
+    if (flock(fd_, LOCK_EX) != 0) { return false; }
+
+    const std::string game_name = Environment().name();
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) != 0) { return false; }
+    bool is_new_file = (file_stat.st_size == 0);
+    if (!is_new_file) {
+        // an existing file keeps its own size
+        Header header;
+        if (pread(fd_, &header, sizeof(Header), 0) != static_cast<ssize_t>(sizeof(Header))) { return false; }
+        if (memcmp(header.magic_, kSolvedPositionDBMagic, sizeof(header.magic_)) != 0 || header.version_ != kVersion) { return false; }
+        if (header.board_size_ != static_cast<uint32_t>(gamesolver::env_board_size) || strncmp(header.game_name_, game_name.c_str(), sizeof(header.game_name_)) != 0 || header.solved_player_ != gamesolver::solved_player) {
+            std::cerr << file_name << " was created for another game, board size or solved player" << std::endl;
+            return false;
+        }
+        num_entries = header.num_entries_;
+    }
+
+    file_size_ = sizeof(Header) + num_entries * sizeof(Entry);
+    if (is_new_file && ftruncate(fd_, file_size_) != 0) { return false; }
+    if (!is_new_file && static_cast<size_t>(file_stat.st_size) < file_size_) { return false; }
+    mapped_ = mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapped_ == MAP_FAILED) {
+        mapped_ = nullptr;
+        return false;
+    }
+
+    Header* header = static_cast<Header*>(mapped_);
+    if (is_new_file) {
+        memcpy(header->magic_, kSolvedPositionDBMagic, sizeof(header->magic_));
+        header->version_ = kVersion;
+        header->board_size_ = gamesolver::env_board_size;
+        header->num_entries_ = num_entries;
+        strncpy(header->game_name_, game_name.c_str(), sizeof(header->game_name_) - 1);
+        header->solved_player_ = gamesolver::solved_player;
+    }
+    num_entries_ = num_entries;
+    entries_ = reinterpret_cast<Entry*>(header + 1);
+    return (flock(fd_, LOCK_UN) == 0);
+}
+
+void SolvedPositionDB::close()
+{
+    if (mapped_) { munmap(mapped_, file_size_); }
+    if (fd_ >= 0) { ::close(fd_); }
+    fd_ = -1;
+    file_size_ = 0;
+    mapped_ = nullptr;
+    entries_ = nullptr;
+    num_entries_ = 0;
+}
+
+} // namespace gamesolver
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "gs_bitboard.h"
+#include "gs_hashkey.h"
+#include "gs_mcts.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace gamesolver {
+
+// On-disk store of solved positions shared across runs, an open-addressing table in a memory-mapped file keyed by
+// getPositionHashKey. Entries are claimed and published with atomic operations, so several processes on the same host
+// can append to the same file. Results depending on GHI are never stored since they are only valid for their history.
+class SolvedPositionDB {
+public:
+    static SolvedPositionDB& instance();
+    ~SolvedPositionDB();
+
+    bool lookup(GSHashKey key, SolverStatus& solver_status, GSBitboard& rzone_bitboard);
+    bool store(GSHashKey key, SolverStatus solver_status, const GSBitboard& rzone_bitboard);
+
+    inline bool isOpen() const { return entries_ != nullptr; }
+    inline uint64_t getNumHits() const { return num_hits_; }
+    inline uint64_t getNumStores() const { return num_stores_; }
+    std::string toString() const;
+
+private:
+    class Header {
+    public:
+        char magic_[8];
+        uint32_t version_;
+        uint32_t board_size_;
+        uint64_t num_entries_;
+        char game_name_[32]; // Environment::name(), zero padded
+        char solved_player_;
+        uint8_t reserved_[7];
+    };
+
+    class Entry {
+    public:
+        uint64_t key_;       // 0 for an empty entry, claimed before the result is written
+        uint64_t rzone_;
+        int8_t solver_status_;
+        uint8_t is_ready_;   // set after the result is written
+        uint8_t reserved_[6];
+    };
+
+    SolvedPositionDB();
+    bool open(const std::string& file_name, uint64_t num_entries);
+    void close();
+
+    static constexpr uint32_t kVersion = 2;
+    static constexpr int kMaxProbes = 16;
+    int fd_;
+    size_t file_size_;
+    void* mapped_;
+    Entry* entries_;
+    uint64_t num_entries_;
+    std::atomic<uint64_t> num_hits_;
+    std::atomic<uint64_t> num_stores_;
+};
+
+} // namespace gamesolver
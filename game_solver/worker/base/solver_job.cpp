@@ -14,6 +14,7 @@ SolverJob::SolverJob(const std::string& sgf, float pcn_value, const std::vector<
     reset();
     sgf_ = sgf;
     pcn_value_ = pcn_value;
+    priority_ = pcn_value;
     node_path_ = node_path;
 }
 
@@ -22,16 +23,21 @@ void SolverJob::reset()
     job_id_ = -1ULL;
     sgf_ = "(;FF[4]CA[UTF-8]SZ[" + std::to_string(gamesolver::env_board_size) + "]KM[0])";
     pcn_value_ = 0.0f;
+    priority_ = 0.0f;
+    max_nodes_ = 0;
+    time_limit_ = 0.0f;
     node_path_.clear();
     solver_status_ = SolverStatus::kSolverUnknown;
     rzone_bitboard_.reset();
     ghi_data_.reset();
     nodes_ = 0;
+    tree_summary_.clear();
+    is_split_ = false;
 }
 
 bool SolverJob::setJob(const std::string& job_string)
 {
-    // job format: job_id sgf [other arguments]
+    // job format: job_id sgf [pcn_value] [priority] [max_nodes] [time_limit]
     std::vector<std::string> args = stringToVector(job_string);
     if (args.size() < 2) { return false; }
 
@@ -46,12 +52,15 @@ bool SolverJob::setJob(const std::string& job_string)
     job_id_ = job_id;
     sgf_ = sgf;
     if (args.size() >= 3) { pcn_value_ = std::stof(args[2]); }
+    priority_ = (args.size() >= 4 ? std::stof(args[3]) : pcn_value_);
+    if (args.size() >= 5) { max_nodes_ = std::stoi(args[4]); }
+    if (args.size() >= 6) { time_limit_ = std::stof(args[5]); }
     return true;
 }
 
 bool SolverJob::setJobResult(const std::string& job_result_string)
 {
-    // job result format: solver_results rzone_bitboard nodes ghi_string
+    // job result format: solver_results rzone_bitboard nodes ghi_string [tree_summary] [is_split]
     std::vector<std::string> args = utils::stringToVector(job_result_string);
     if (args.size() < 2) { return false; }
 
@@ -63,28 +72,32 @@ bool SolverJob::setJobResult(const std::string& job_result_string)
     }
     nodes_ = std::stoi(args[2]);
     ghi_data_.parseFromString(args[3].substr(1, args[3].length() - 2));
+    if (args.size() >= 5) { tree_summary_ = args[4].substr(1, args[4].length() - 2); }
+    if (args.size() >= 6) { is_split_ = (std::stoi(args[5]) != 0); }
 
     return true;
 }
 
 std::string SolverJob::getJobString(bool with_job_id /*= true*/) const
 {
-    // job format: job_id sgf [other arguments]
+    // job format: job_id sgf pcn_value priority max_nodes time_limit
     std::ostringstream oss;
     if (with_job_id) { oss << job_id_ << " "; }
-    oss << sgf_ << " " << pcn_value_;
+    oss << sgf_ << " " << pcn_value_ << " " << priority_ << " " << max_nodes_ << " " << time_limit_;
     return oss.str();
 }
 
 std::string SolverJob::getJobResultString(bool with_job_id /*= true*/) const
 {
-    // job result format: job_id solver_results rzone_bitboard nodes ghi_string
+    // job result format: job_id solver_results rzone_bitboard nodes ghi_string tree_summary is_split
     std::ostringstream oss;
     if (with_job_id) { oss << job_id_ << " "; }
     oss << static_cast<int>(solver_status_) << " "
         << std::hex << rzone_bitboard_.to_ullong() << " " // TODO: avoid using more than 64-bit bitboard
         << std::dec << nodes_ << " "
-        << "\"" << ghi_data_.toString() << "\"";
+        << "\"" << ghi_data_.toString() << "\" "
+        << "\"" << tree_summary_ << "\" "
+        << is_split_;
     return oss.str();
 }
 
@@ -24,12 +24,17 @@ public:
     std::string sgf_;
     std::vector<minizero::actor::MCTSNode*> node_path_;
     float pcn_value_;
+    float priority_; // lower runs first in the worker queue
+    int max_nodes_;   // simulation budget, 0 for actor_num_simulation
+    float time_limit_; // seconds, 0 for no limit
 
     // job results
     SolverStatus solver_status_;
     GSBitboard rzone_bitboard_;
     int nodes_;
     GHIData ghi_data_;
+    std::string tree_summary_; // see TreeSummary, only for unsolved jobs
+    bool is_split_;            // stopped at the split budget, the unsolved leaves of the summary become sub-jobs
 };
 
 } // namespace gamesolver
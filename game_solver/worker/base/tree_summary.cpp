@@ -0,0 +1,83 @@
+#include "tree_summary.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace gamesolver {
+
+std::string TreeSummary::summarize(const GSMCTS& mcts, int depth)
+{
+    // summary format: children of the root separated by ';', each child is
+    // action_id,policy,count,mean,value,solver_status,rzone_bitboard followed by its own children in parentheses if expanded
+    std::ostringstream oss;
+    if (depth > 0) { summarizeChildren(oss, mcts, mcts.getRootNode(), depth); }
+    return oss.str();
+}
+
+bool TreeSummary::parseFromString(const std::string& summary_string)
+{
+    children_.clear();
+    size_t index = 0;
+    if (!parseChildren(summary_string, index, children_) || index != summary_string.length()) {
+        children_.clear();
+        return false;
+    }
+    return true;
+}
+
+void TreeSummary::summarizeChildren(std::ostringstream& oss, const GSMCTS& mcts, const GSMCTSNode* node, int depth)
+{
+    // all children are listed since the manager expands the node with them
+    for (int i = 0; i < node->getNumChildren(); ++i) {
+        const GSMCTSNode* child = node->getChild(i);
+        // solutions depending on the history (GHI) are only valid in the worker's tree
+        bool is_solved = (child->isSolved() && !child->isGHI() && child->getRZoneDataIndex() != -1);
+        if (i > 0) { oss << ";"; }
+        oss << child->getAction().getActionID() << ","
+            << child->getPolicy() << ","
+            << child->getCount() << ","
+            << child->getMean() << ","
+            << child->getValue() << ","
+            << static_cast<int>(is_solved ? child->getSolverStatus() : SolverStatus::kSolverUnknown) << ","
+            << std::hex << (is_solved ? mcts.getTreeRZoneData().getData(child->getRZoneDataIndex()).getRZone().to_ullong() : 0) << std::dec;
+        if (depth > 1 && !child->isLeaf() && !is_solved) {
+            oss << "(";
+            summarizeChildren(oss, mcts, child, depth - 1);
+            oss << ")";
+        }
+    }
+}
+
+bool TreeSummary::parseChildren(const std::string& summary_string, size_t& index, std::vector<Node>& children)
+{
+    while (index < summary_string.length() && summary_string[index] != ')') {
+        if (!children.empty()) {
+            if (summary_string[index] != ';') { return false; }
+            ++index;
+        }
+
+        size_t end = summary_string.find_first_of(";()", index);
+        if (end == std::string::npos) { end = summary_string.length(); }
+        std::istringstream iss(summary_string.substr(index, end - index));
+        Node node;
+        int solver_status = 0;
+        unsigned long long rzone_bitboard = 0;
+        char comma[6];
+        iss >> node.action_id_ >> comma[0] >> node.policy_ >> comma[1] >> node.count_ >> comma[2] >> node.mean_ >> comma[3] >> node.value_ >> comma[4] >> solver_status >> comma[5] >> std::hex >> rzone_bitboard;
+        if (iss.fail()) { return false; }
+        node.solver_status_ = static_cast<SolverStatus>(solver_status);
+        node.rzone_bitboard_ = rzone_bitboard;
+        index = end;
+
+        if (index < summary_string.length() && summary_string[index] == '(') {
+            ++index;
+            if (!parseChildren(summary_string, index, node.children_)) { return false; }
+            if (index >= summary_string.length() || summary_string[index] != ')') { return false; }
+            ++index;
+        }
+        children.push_back(node);
+    }
+    return true;
+}
+
+} // namespace gamesolver
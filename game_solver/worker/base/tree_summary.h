@@ -0,0 +1,36 @@
+#pragma once
+
+#include "gs_mcts.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace gamesolver {
+
+// the top plies of an unsolved job's search tree, returned to the manager so that the work is not repeated
+class TreeSummary {
+public:
+    class Node {
+    public:
+        int action_id_;
+        float policy_;
+        int count_;
+        float mean_;
+        float value_;
+        SolverStatus solver_status_;
+        GSBitboard rzone_bitboard_;
+        std::vector<Node> children_;
+    };
+
+    static std::string summarize(const GSMCTS& mcts, int depth);
+    bool parseFromString(const std::string& summary_string);
+    inline const std::vector<Node>& getChildren() const { return children_; }
+
+private:
+    static void summarizeChildren(std::ostringstream& oss, const GSMCTS& mcts, const GSMCTSNode* node, int depth);
+    bool parseChildren(const std::string& summary_string, size_t& index, std::vector<Node>& children);
+
+    std::vector<Node> children_;
+};
+
+} // namespace gamesolver
@@ -47,6 +47,21 @@ std::vector<GSHashKey> HexKnowledgeHandler::getHashKeySequenceInBitboard(const H
     return hashkey_sequence;
 }
 
+GSHashKey HexKnowledgeHandler::getPositionHashKey(const HexEnv& env)
+{
+    GSHashKey position_hash_key = (env.getTurn() == env::Player::kPlayer2 ? turn_hash_key : 0);
+    env::GamePair<GSBitboard> stone_bitboard = getStoneBitboard(env);
+    for (auto player : {env::Player::kPlayer1, env::Player::kPlayer2}) {
+        GSBitboard bitboard = stone_bitboard.get(player);
+        while (!bitboard.none()) {
+            int pos = bitboard._Find_first();
+            bitboard.reset(pos);
+            position_hash_key ^= getPlayerHashKey(pos, player);
+        }
+    }
+    return position_hash_key;
+}
+
 #endif
 
 } // namespace gamesolver
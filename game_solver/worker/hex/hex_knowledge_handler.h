@@ -11,11 +11,14 @@ namespace gamesolver {
 #if HEX
 class HexKnowledgeHandler : public KnowledgeHandler {
 public:
-    minizero::env::GamePair<GSBitboard> getStoneBitboard(const minizero::env::hex::HexEnv& env) const;
+    minizero::env::GamePair<GSBitboard> getStoneBitboard(const minizero::env::hex::HexEnv& env) const override;
+    std::vector<minizero::utils::Rotation> getSymmetries() const override { return {minizero::utils::Rotation::kRotationNone, minizero::utils::Rotation::kRotation180}; }
 
     minizero::env::Player getWinner(const minizero::env::hex::HexEnv& env) override;
     std::vector<GSHashKey> getHashKeySequence(const minizero::env::hex::HexEnv& env) override;
     std::vector<GSHashKey> getHashKeySequenceInBitboard(const minizero::env::hex::HexEnv& env, GSBitboard bitboard) override;
+    GSHashKey getPositionHashKey(const minizero::env::hex::HexEnv& env) override;
+    int getKoPosition(const minizero::env::hex::HexEnv& env) override { return -1; }
     void findGHI(const minizero::env::hex::HexEnv& env, std::vector<minizero::actor::MCTSNode*>& node_path, std::shared_ptr<GSMCTS> mcts) override { return; }
     std::vector<minizero::env::GamePair<GSBitboard>> getAncestorPositions(const minizero::env::hex::HexEnv& env, const std::vector<minizero::actor::MCTSNode*>& node_path) override { return {}; }
 };
@@ -116,6 +116,28 @@ int KillallGoKnowledgeHandler::getWinByKoPosition(const KillAllGoEnv& env, const
     return -1;
 }
 
+GSHashKey KillallGoKnowledgeHandler::getPositionHashKey(const KillAllGoEnv& env)
+{
+    // the env hash key covers the stones and the turn, a ko also bans retaking at once
+    GSHashKey position_hash_key = env.getHashKey();
+    int ko_position = getKoPosition(env);
+    return (ko_position == -1 ? position_hash_key : position_hash_key ^ getPlayerHashKey(ko_position, Player::kPlayerNone));
+}
+
+int KillallGoKnowledgeHandler::getKoPosition(const KillAllGoEnv& env)
+{
+    if (env.getActionHistory().empty() || env.isPassAction(env.getActionHistory().back())) { return -1; }
+
+    const GoGrid& grid = env.getGrid(env.getActionHistory().back().getActionID());
+    for (const auto& neighbor_pos : grid.getNeighbors()) {
+        if (env.getGrid(neighbor_pos).getPlayer() != Player::kPlayerNone) { continue; }
+
+        KillAllGoAction ko_action(neighbor_pos, env.getTurn());
+        if (isEatKoMove(env, ko_action) && !env.isLegalAction(ko_action)) { return neighbor_pos; }
+    }
+    return -1;
+}
+
 GoBitboard KillallGoKnowledgeHandler::getStoneBitBoardAfterPlay(const KillAllGoEnv& env, const KillAllGoAction& action)
 {
     assert(!env.isPassAction(action));
@@ -373,6 +395,13 @@ std::vector<env::GamePair<GSBitboard>> KillallGoKnowledgeHandler::getAncestorPos
 
     return ancestor_positions;
 }
+
+std::vector<utils::Rotation> KillallGoKnowledgeHandler::getSymmetries() const
+{
+    std::vector<utils::Rotation> symmetries;
+    for (int rotation = 0; rotation < static_cast<int>(utils::Rotation::kRotateSize); ++rotation) { symmetries.push_back(static_cast<utils::Rotation>(rotation)); }
+    return symmetries;
+}
 #endif
 
 } // namespace gamesolver
@@ -28,8 +28,12 @@ public:
     minizero::env::Player getWinner(const minizero::env::killallgo::KillAllGoEnv& env) override;
     std::vector<GSHashKey> getHashKeySequence(const minizero::env::killallgo::KillAllGoEnv& env) override;
     std::vector<GSHashKey> getHashKeySequenceInBitboard(const minizero::env::killallgo::KillAllGoEnv& env, GSBitboard bitboard) override;
+    GSHashKey getPositionHashKey(const minizero::env::killallgo::KillAllGoEnv& env) override;
+    int getKoPosition(const minizero::env::killallgo::KillAllGoEnv& env) override;
     void findGHI(const minizero::env::killallgo::KillAllGoEnv& env, std::vector<minizero::actor::MCTSNode*>& node_path, std::shared_ptr<GSMCTS> mcts) override;
     std::vector<minizero::env::GamePair<GSBitboard>> getAncestorPositions(const minizero::env::killallgo::KillAllGoEnv& env, const std::vector<minizero::actor::MCTSNode*>& node_path) override;
+    minizero::env::GamePair<GSBitboard> getStoneBitboard(const minizero::env::killallgo::KillAllGoEnv& env) const override { return env.getStoneBitboard(); }
+    std::vector<minizero::utils::Rotation> getSymmetries() const override;
 };
 #endif
 
@@ -1,8 +1,13 @@
 #include "solver_group.h"
+#include "gs_configuration.h"
+#include "pcn_cache.h"
 #include "utils.h"
+#include <algorithm>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <torch/cuda.h>
+#include <vector>
 
 namespace gamesolver {
 
@@ -17,23 +22,63 @@ bool SolverSlaveThread::doCPUJob()
 
     std::shared_ptr<Solver> solver = std::static_pointer_cast<Solver>(getSharedData()->actors_[worker_id]);
     if (solver->isIdle()) { return true; }
+    if (gamesolver::use_async_inference) {
+        if (!solver->isSearchDone()) { solver->stepAsync(); }
+        if (!solver->isSearchDone() && solver->reachSplitBudget()) { solver->splitJob(); }
+        if (solver->isSearchDone()) {
+            solver->finishSearch();
+            solver_group_.notifySearchDone(worker_id);
+        }
+        return true;
+    }
+
     int network_id = worker_id % getSharedData()->networks_.size();
     int network_output_id = solver->getNNEvaluationBatchIndex();
     if (network_output_id >= 0) {
         assert(network_output_id < static_cast<int>(getSharedData()->network_outputs_[network_id].size()));
         solver->afterNNEvaluation(getSharedData()->network_outputs_[network_id][network_output_id]);
+    } else if (solver->getCachedNNOutput()) {
+        solver->afterNNEvaluation(solver->getCachedNNOutput());
     }
+    if (!solver->isSearchDone() && solver->reachSplitBudget()) { solver->splitJob(); }
 
-    if (!solver->isSearchDone()) { solver->beforeNNEvaluation(); }
+    if (!solver->isSearchDone()) {
+        solver->beforeNNEvaluation();
+    } else {
+        solver->finishSearch();
+        solver_group_.notifySearchDone(worker_id);
+    }
     return true;
 }
 
+void SolverSlaveThread::doGPUJob()
+{
+    // the inference service owns the networks in async mode
+    if (gamesolver::use_async_inference) { return; }
+    GSSlaveThread::doGPUJob();
+}
+
 void SolverGroup::initialize()
 {
     GSActorGroup::initialize();
     std::cout << "num_solvers " << getSharedData()->actors_.size() << "\n\n";
     running_ = true;
     quit_ = false;
+    num_seen_inference_batches_ = 0;
+    num_queued_jobs_ = 0;
+    num_finished_jobs_ = 0;
+    // no job has finished yet, so assume the worst case until the estimate is learned
+    job_memory_estimate_ = std::static_pointer_cast<Solver>(getSharedData()->actors_[0])->getMaxMemoryUsage();
+    start_time_ = std::chrono::steady_clock::now();
+    for (size_t solver_id = 0; solver_id < getSharedData()->actors_.size(); ++solver_id) { idle_solver_ids_.push_back(solver_id); }
+    if (gamesolver::use_broker) { broker_adapter_ = std::make_shared<WorkerBrokerAdapter>(getSharedData()->actors_.size(), [this](const std::string& command) { pushCommand(command); }); }
+}
+
+void SolverGroup::notifySearchDone(int solver_id)
+{
+    // called by slave threads, each solver is reported at most once per step since it is reset right after the step
+    std::lock_guard<std::mutex> lock(finished_mutex_);
+    finished_solver_ids_.push_back(solver_id);
 }
 
 void SolverGroup::createActors()
@@ -41,37 +86,110 @@ void SolverGroup::createActors()
     assert(getSharedData()->networks_.size() > 0);
     std::shared_ptr<Network>& network = getSharedData()->networks_[0];
     uint64_t tree_node_size = static_cast<uint64_t>(config::actor_num_simulation + 1) * network->getActionSize();
+    if (gamesolver::use_async_inference) { inference_service_ = std::make_shared<PCNInferenceService>(getSharedData()->networks_, config::actor_num_parallel_games, gamesolver::nn_inference_max_batch_size, gamesolver::nn_inference_timeout_us); }
     for (int i = 0; i < config::actor_num_parallel_games; ++i) {
         getSharedData()->actors_.emplace_back(std::make_shared<Solver>(tree_node_size));
         getSharedData()->actors_.back()->setNetwork(getSharedData()->networks_[i % getSharedData()->networks_.size()]);
         getSharedData()->actors_.back()->reset();
+        if (inference_service_) { std::static_pointer_cast<Solver>(getSharedData()->actors_.back())->setInferenceService(inference_service_, i); }
     }
 }
 
-void SolverGroup::handleFinishedGame()
+void SolverGroup::handleIO()
+{
+    // same as ActorGroup::handleIO, but also wakes up handleFinishedGame when all solvers are waiting for jobs
+    std::string command;
+    while (getline(std::cin, command)) { pushCommand(command); }
+}
+
+void SolverGroup::pushCommand(const std::string& command)
 {
     std::lock_guard<std::mutex> lock(getSharedData()->mutex_);
-    size_t num_idle_workers = 0;
-    for (auto actor : getSharedData()->actors_) {
-        std::shared_ptr<Solver> solver = std::static_pointer_cast<Solver>(actor);
-        if (solver->isIdle() && !job_queue_.empty()) {
-            solver->setSolverJob(job_queue_.front());
-            job_queue_.pop_front();
-        } else if (!solver->isIdle() && solver->isSearchDone()) {
+    commands_.push_back(command);
+    command_cv_.notify_one();
+}
+
+void SolverGroup::handleFinishedGame()
+{
+    std::unique_lock<std::mutex> lock(getSharedData()->mutex_);
+    {
+        std::lock_guard<std::mutex> finished_lock(finished_mutex_);
+        for (int solver_id : finished_solver_ids_) {
+            std::shared_ptr<Solver> solver = getSolver(solver_id);
             std::cout << solver->getSolverJob().getJobResultString() << "\n\n"
                       << std::flush;
+            if (broker_adapter_) { broker_adapter_->respondJob(solver->getSolverJob().job_id_, solver->getSolverJob().getJobResultString(false)); }
+            updateJobMemoryEstimate(solver->getMemoryUsage());
             solver->reset();
+            idle_solver_ids_.push_back(solver_id);
         }
+        finished_solver_ids_.clear();
+    }
+    dispatchJobs();
 
-        // count number of idle solvers
-        if (solver->isIdle()) { ++num_idle_workers; }
+    if (idle_solver_ids_.size() == getSharedData()->actors_.size()) {
+        if (quit_) {
+            if (gamesolver::use_pcn_cache) { std::cerr << PCNCache::instance().toString() << std::endl; }
+            exit(0);
+        }
+        // nothing is running, sleep until the next command arrives
+        command_cv_.wait(lock, [this] { return !commands_.empty(); });
+    } else if (inference_service_) {
+        // solvers have nothing to do until some of their leaves are evaluated
+        lock.unlock();
+        inference_service_->waitForCompletions(num_seen_inference_batches_, gamesolver::nn_inference_timeout_us);
     }
+}
+
+void SolverGroup::dispatchJobs()
+{
+    const uint64_t memory_budget = static_cast<uint64_t>(gamesolver::worker_memory_budget_mb) << 20;
+    uint64_t memory_usage = (memory_budget > 0 ? getMemoryUsage() : 0);
+    while (!idle_solver_ids_.empty() && !job_queue_.empty()) {
+        // a job is always admitted when nothing is running, so an undersized budget degrades to one job at a time
+        bool is_running = (idle_solver_ids_.size() < getSharedData()->actors_.size());
+        if (memory_budget > 0 && is_running && memory_usage + job_memory_estimate_ > memory_budget) { break; }
 
-    // If there are no running solvers, sleep 100 ms
-    if (num_idle_workers == getSharedData()->actors_.size() && job_queue_.empty()) {
-        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
-        if (quit_) { exit(0); }
+        getSolver(idle_solver_ids_.front())->setSolverJob(job_queue_.top().solver_job_);
+        idle_solver_ids_.pop_front();
+        job_queue_.pop();
+        memory_usage += job_memory_estimate_;
+    }
+    if (memory_budget > 0 && broker_adapter_) { broker_adapter_->setCapacity(getEffectiveCapacity(memory_usage, memory_budget)); }
+}
+
+uint64_t SolverGroup::getMemoryUsage()
+{
+    uint64_t memory_usage = 0;
+    for (size_t solver_id = 0; solver_id < getSharedData()->actors_.size(); ++solver_id) {
+        std::shared_ptr<Solver> solver = getSolver(solver_id);
+        if (!solver->isIdle()) { memory_usage += solver->getMemoryUsage(); }
     }
+    return memory_usage;
+}
+
+int SolverGroup::getEffectiveCapacity(uint64_t memory_usage, uint64_t memory_budget) const
+{
+    // running solvers plus the number of estimated jobs that still fit into the budget
+    int num_solvers = getSharedData()->actors_.size();
+    int num_running = num_solvers - idle_solver_ids_.size();
+    int num_admissible = (memory_usage < memory_budget ? static_cast<int>((memory_budget - memory_usage) / job_memory_estimate_) : 0);
+    return std::max(1, std::min(num_solvers, num_running + num_admissible));
+}
+
+void SolverGroup::updateJobMemoryEstimate(uint64_t job_memory_usage)
+{
+    // trees only grow during a search, so the usage at the end of a job is its peak
+    job_memory_estimate_ = (num_finished_jobs_++ == 0 ? job_memory_usage : kJobMemoryEstimateDecay * job_memory_estimate_ + (1.0 - kJobMemoryEstimateDecay) * job_memory_usage);
+    job_memory_estimate_ = std::max(job_memory_estimate_, 1.0);
+}
+
+void SolverGroup::pushJob(const SolverJob& solver_job)
+{
+    // aging lowers the priority of a waiting job by rate * waiting_time, i.e. its key is priority - rate * (now - enqueue_time);
+    // "- rate * now" is shared by all jobs, so ordering by priority + rate * enqueue_time never needs re-sorting
+    float enqueue_time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time_).count();
+    job_queue_.emplace(solver_job, solver_job.priority_ + gamesolver::solver_job_aging_rate * enqueue_time, num_queued_jobs_++);
 }
 
 void SolverGroup::handleCommand(const std::string& command_prefix, const std::string& command)
@@ -79,13 +197,16 @@ void SolverGroup::handleCommand(const std::string& command_prefix, const std::st
     if (command_prefix == "+") {
         SolverJob solver_job;
         if (!solver_job.setJob(command.substr(command.find(' ') + 1))) { std::cerr << "set job failed, job string: \"" << command << "\"" << std::endl; }
-        job_queue_.push_back(solver_job);
+        pushJob(solver_job);
+        dispatchJobs();
     } else if (command_prefix == "-") {
         uint64_t job_id = std::stoull(command.substr(command.find(' ') + 1));
-        for (auto& actor : getSharedData()->actors_) {
-            std::shared_ptr<Solver> solver = std::static_pointer_cast<Solver>(actor);
-            if (solver->getSolverJob().job_id_ != job_id) { continue; }
+        for (size_t solver_id = 0; solver_id < getSharedData()->actors_.size(); ++solver_id) {
+            std::shared_ptr<Solver> solver = getSolver(solver_id);
+            if (solver->isIdle() || solver->getSolverJob().job_id_ != job_id) { continue; }
             solver->reset();
+            idle_solver_ids_.push_back(solver_id);
+            dispatchJobs();
             break;
         }
     } else if (command_prefix == "quit") {
@@ -1,20 +1,46 @@
 #pragma once
 
 #include "gs_actor_group.h"
+#include "pcn_inference_service.h"
 #include "solver.h"
+#include "worker_broker_adapter.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <memory>
+#include <mutex>
+#include <queue>
 #include <string>
+#include <vector>
 
 namespace gamesolver {
 
+class SolverGroup;
+
 class SolverSlaveThread : public GSSlaveThread {
 public:
-    SolverSlaveThread(int id, std::shared_ptr<minizero::utils::BaseSharedData> shared_data)
-        : GSSlaveThread(id, shared_data) {}
+    SolverSlaveThread(int id, std::shared_ptr<minizero::utils::BaseSharedData> shared_data, SolverGroup& solver_group)
+        : GSSlaveThread(id, shared_data), solver_group_(solver_group) {}
 
 private:
     bool doCPUJob() override;
+    void doGPUJob() override;
+
+    SolverGroup& solver_group_;
+};
+
+class QueuedSolverJob {
+public:
+    QueuedSolverJob(const SolverJob& solver_job, float key, uint64_t order)
+        : solver_job_(solver_job), key_(key), order_(order) {}
+
+    // std::priority_queue pops the largest element, so the smallest key (then the earliest job) compares largest
+    inline bool operator<(const QueuedSolverJob& rhs) const { return (key_ != rhs.key_ ? key_ > rhs.key_ : order_ > rhs.order_); }
+
+    SolverJob solver_job_;
+    float key_;
+    uint64_t order_;
 };
 
 class SolverGroup : public GSActorGroup {
@@ -22,16 +48,38 @@ public:
     SolverGroup() {}
 
     void initialize() override;
+    void notifySearchDone(int solver_id);
 
 private:
     void createActors() override;
+    void handleIO() override;
+    void pushCommand(const std::string& command);
     void handleFinishedGame() override;
     void handleCommand(const std::string& command_prefix, const std::string& command) override;
+    void dispatchJobs();
+    uint64_t getMemoryUsage();
+    int getEffectiveCapacity(uint64_t memory_usage, uint64_t memory_budget) const;
+    void updateJobMemoryEstimate(uint64_t job_memory_usage);
+    void pushJob(const SolverJob& solver_job);
 
-    std::shared_ptr<minizero::utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<SolverSlaveThread>(id, shared_data_); }
+    std::shared_ptr<minizero::utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<SolverSlaveThread>(id, shared_data_, *this); }
+    inline std::shared_ptr<Solver> getSolver(int solver_id) { return std::static_pointer_cast<Solver>(getSharedData()->actors_[solver_id]); }
 
     bool quit_;
-    std::deque<SolverJob> job_queue_;
+    std::priority_queue<QueuedSolverJob> job_queue_;
+    uint64_t num_queued_jobs_;
+    uint64_t num_finished_jobs_;
+    double job_memory_estimate_; // bytes, moving average of the peak memory of finished jobs
+    std::chrono::steady_clock::time_point start_time_;
+    std::deque<int> idle_solver_ids_;
+    std::condition_variable command_cv_;
+    std::mutex finished_mutex_;
+    std::vector<int> finished_solver_ids_;
+    std::shared_ptr<PCNInferenceService> inference_service_;
+    std::shared_ptr<WorkerBrokerAdapter> broker_adapter_;
+
+    const double kJobMemoryEstimateDecay = 0.9;
+    uint64_t num_seen_inference_batches_;
 };
 
 } // namespace gamesolver
@@ -0,0 +1,117 @@
+#include "worker_broker_adapter.h"
+#include "gs_configuration.h"
+#include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
+#include <boost/regex.hpp>
+#include <string>
+
+namespace gamesolver {
+
+static boost::regex _regex_worker_request("^request ([0-9]+) \\{(.+)\\}$");
+static boost::regex _regex_worker_terminate("^terminate ([0-9]+)$");
+static boost::regex _regex_worker_confirm_response("^(accept|reject) response ([0-9]+)$");
+static boost::regex _regex_worker_query_state("^(query|report) (state|status)$");
+static boost::regex _regex_worker_load_model("^solver (load_model .+)$");
+
+WorkerBrokerAdapter::WorkerBrokerAdapter(int capacity, std::function<void(const std::string&)> command_handler)
+    : chat::BrokerAdapter(),
+      capacity_(capacity),
+      command_handler_(command_handler)
+{
+    setBrokerName(gamesolver::broker_name);
+    setAdapterName(gamesolver::broker_adapter_name);
+    connect(gamesolver::broker_host, gamesolver::broker_port);
+}
+
+void WorkerBrokerAdapter::respondJob(uint64_t job_id, const std::string& job_result)
+{
+    {
+        std::scoped_lock lock(job_mutex_);
+        if (running_jobs_.erase(job_id) == 0) { return; } // terminated by the broker
+    }
+    outputAsync("response " + std::to_string(job_id) + " 0 {" + encodeOutput(job_result) + "}");
+    notifyState();
+}
+
+void WorkerBrokerAdapter::setCapacity(int capacity)
+{
+    if (capacity_.exchange(capacity) != capacity) { notifyState(); }
+}
+
+void WorkerBrokerAdapter::notifyState()
+{
+    size_t loading = 0;
+    {
+        std::scoped_lock lock(job_mutex_);
+        loading = running_jobs_.size();
+    }
+    const int capacity = capacity_;
+    std::string state = (loading == 0 ? "idle" : (loading < static_cast<size_t>(capacity) ? "busy" : "full"));
+    outputAsync((boost::format("notify state %s %d/%d") % state % loading % capacity).str());
+}
+
+std::string WorkerBrokerAdapter::encodeOutput(const std::string& output)
+{
+    // inverse of Job::decodeOutput
+    std::string encode = output;
+    boost::replace_all(encode, "\\", "\\\\");
+    boost::replace_all(encode, "\n", "\\n");
+    boost::replace_all(encode, "\t", "\\t");
+    return encode;
+}
+
+bool WorkerBrokerAdapter::handleExtendedMessage(const std::string& message, const std::string& sender)
+{
+    boost::smatch match;
+    if (boost::regex_match(message, match, _regex_worker_request)) {
+        // ^request ([0-9]+) \\{(.+)\\}$
+        JobID id = std::stoull(match[1].str());
+        std::string command = match[2].str();
+        bool accepted = (command.find("solve ") == 0);
+        if (accepted) {
+            std::scoped_lock lock(job_mutex_);
+            accepted = (running_jobs_.size() < static_cast<size_t>(capacity_) && running_jobs_.insert(id).second);
+        }
+        outputAsync((accepted ? "accept request " : "reject request ") + std::to_string(id));
+        if (accepted) {
+            command_handler_("+ " + std::to_string(id) + " " + command.substr(command.find(' ') + 1));
+            notifyState();
+        }
+        return true;
+
+    } else if (boost::regex_match(message, match, _regex_worker_terminate)) {
+        // ^terminate ([0-9]+)$
+        JobID id = std::stoull(match[1].str());
+        bool running = false;
+        {
+            std::scoped_lock lock(job_mutex_);
+            running = (running_jobs_.erase(id) > 0);
+        }
+        outputAsync((running ? "accept terminate " : "reject terminate ") + std::to_string(id));
+        if (running) {
+            command_handler_("- " + std::to_string(id));
+            notifyState();
+        }
+        return true;
+
+    } else if (boost::regex_match(message, match, _regex_worker_confirm_response)) {
+        // ^(accept|reject) response ([0-9]+)$
+        if (match[1].str() == "reject") { log((boost::format("response %s rejected by %s") % match[2] % sender).str()); }
+        return true;
+
+    } else if (boost::regex_match(message, match, _regex_worker_query_state)) {
+        // ^(query|report) (state|status)$
+        notifyState();
+        return true;
+
+    } else if (boost::regex_match(message, match, _regex_worker_load_model)) {
+        // ^solver (load_model .+)$
+        command_handler_(match[1].str());
+        outputAsync("confirm solver load_model");
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace gamesolver
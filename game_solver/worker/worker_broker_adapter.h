@@ -0,0 +1,43 @@
+#pragma once
+
+#include "broker_adapter.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace gamesolver {
+
+// Worker side of the broker protocol, replacing the chat worker node and scripts/solver-wrapper.sh:
+// requests from the broker are accepted up to the capacity and turned into solver commands ("+ id job", "- id", "load_model file"),
+// and job results are sent back as responses
+class WorkerBrokerAdapter : public chat::BrokerAdapter {
+public:
+    WorkerBrokerAdapter(int capacity, std::function<void(const std::string&)> command_handler);
+
+    void respondJob(uint64_t job_id, const std::string& job_result);
+    void setCapacity(int capacity);
+
+    inline int getCapacity() const { return capacity_; }
+
+private:
+    void notifyState();
+    static std::string encodeOutput(const std::string& output);
+
+private: // override from chat::BrokerAdapter
+    void onHandshakeCompleted() override { notifyState(); }
+    void onNetworkError(const std::string& msg) override { log("network error: " + msg); }
+    std::list<std::string> listSubscribedItems() const override { return {}; }
+    bool handleExtendedMessage(const std::string& message, const std::string& sender) override;
+
+private:
+    std::atomic<int> capacity_;
+    std::function<void(const std::string&)> command_handler_;
+    std::mutex job_mutex_;
+    std::unordered_set<JobID> running_jobs_;
+};
+
+} // namespace gamesolver